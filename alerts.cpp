@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+#include <fmt/chrono.h>
+
+#include "alerts.hpp"
+#include "state.hpp"
+
+extern char **environ;
+
+Alerts::Alerts(AlertRules rules, std::string source)
+	: rules_(std::move(rules))
+	, source_(std::move(source))
+{
+	if (!rules_.fifo.empty()) {
+		/* a FIFO reader going away must not kill us */
+		std::signal(SIGPIPE, SIG_IGN);
+	}
+}
+
+Alerts::~Alerts()
+{
+	if (fifo_fd_ >= 0) {
+		close(fifo_fd_);
+	}
+	reap();
+}
+
+void Alerts::reap()
+{
+	/* only our own commands: other children are waited for by whoever started them */
+	std::erase_if(children_, [](pid_t pid) {
+		return waitpid(pid, nullptr, WNOHANG) != 0;
+	});
+}
+
+void Alerts::evaluate(const Result &r, const Measurement &m)
+{
+	/* reap alert commands that have finished since the last measurement */
+	reap();
+
+	if (rules_.power_above) {
+		if (m.pwr > *rules_.power_above) {
+			if (!power_above_since_) {
+				power_above_since_ = m.stamp;
+			}
+			fp_seconds above{m.stamp - *power_above_since_};
+			if (!power_fired_ && above >= rules_.power_for) {
+				power_fired_ = true;
+				fire("power", m, fmt::format(
+					"input power {:.1f} W above {:.1f} W for {:.1f} s",
+					m.pwr, *rules_.power_above, above.count()
+				));
+			}
+		} else {
+			power_above_since_.reset();
+			power_fired_ = false;
+		}
+	}
+
+	if (rules_.daily_budget_kwh) {
+		auto zone = local_zone();
+
+		auto day = std::chrono::floor<std::chrono::days>(ts_zoned{zone, m.stamp}.get_local_time());
+		if (day != day_) {
+			day_ = day;
+			day_energy_j_ = 0;
+			budget_fired_ = false;
+		}
+		day_energy_j_ += r.total.energy_j - last_energy_j_;
+		last_energy_j_ = r.total.energy_j;
+
+		double day_energy_kwh = day_energy_j_ / 3600 / 1000;
+		if (!budget_fired_ && day_energy_kwh > *rules_.daily_budget_kwh) {
+			budget_fired_ = true;
+			fire("budget", m, fmt::format(
+				"daily energy {:.2f} kWh above budget of {:.2f} kWh",
+				day_energy_kwh, *rules_.daily_budget_kwh
+			));
+		}
+	}
+
+	if (rules_.rollover) {
+		if (r.power_losses != power_losses_) {
+			fire("power-loss", m, fmt::format("power loss detected (uptime {:.0f} s)", m.uptime_cur));
+		} else if (r.rollovers != rollovers_) {
+			fire("rollover", m, fmt::format("rollover detected (uptime {:.0f} s)", m.uptime_cur));
+		}
+		rollovers_ = r.rollovers;
+		power_losses_ = r.power_losses;
+	}
+}
+
+void Alerts::save(StateWriter &w) const
+{
+	w.put<uint8_t>(power_above_since_.has_value());
+	w.put<int64_t>(power_above_since_.value_or(ts_time{}).time_since_epoch().count());
+	w.put<uint8_t>(power_fired_);
+	w.put<int32_t>(day_.time_since_epoch().count());
+	w.put<double>(day_energy_j_);
+	w.put<double>(last_energy_j_);
+	w.put<uint8_t>(budget_fired_);
+	w.put<uint32_t>(rollovers_);
+	w.put<uint32_t>(power_losses_);
+}
+
+void Alerts::restore(StateReader &r)
+{
+	bool above = r.get<uint8_t>();
+	auto since = ts_time{ts_time::duration{r.get<int64_t>()}};
+	power_above_since_ = above ? std::optional(since) : std::nullopt;
+	power_fired_ = r.get<uint8_t>();
+	day_ = std::chrono::local_days{std::chrono::days{r.get<int32_t>()}};
+	day_energy_j_ = r.get<double>();
+	last_energy_j_ = r.get<double>();
+	budget_fired_ = r.get<uint8_t>();
+	rollovers_ = r.get<uint32_t>();
+	power_losses_ = r.get<uint32_t>();
+}
+
+void Alerts::fire(std::string_view kind, const Measurement &m, const std::string &message)
+{
+	if (!armed_) {
+		return;
+	}
+
+	fmt::print(stderr, "Alert: {} in {} at {}: {}\n", kind, source_, m.stamp, message);
+
+	if (!rules_.exec.empty()) {
+		notify_exec(kind, m, message);
+	}
+	if (!rules_.fifo.empty()) {
+		notify_fifo(fmt::format("{}\t{}\t{}\t{}\n", kind, source_, m.stamp, message));
+	}
+}
+
+void Alerts::notify_exec(std::string_view kind, const Measurement &m, const std::string &message)
+{
+	std::vector<std::string> extra_env = {
+		fmt::format("LIQUIDCTL_ENERGY_ALERT={}", kind),
+		fmt::format("LIQUIDCTL_ENERGY_SOURCE={}", source_),
+		fmt::format("LIQUIDCTL_ENERGY_TIMESTAMP={}", m.stamp),
+		fmt::format("LIQUIDCTL_ENERGY_POWER={}", m.pwr),
+		fmt::format("LIQUIDCTL_ENERGY_MESSAGE={}", message),
+	};
+
+	std::vector<char *> envp;
+	for (char **e = environ; *e; ++e) {
+		envp.push_back(*e);
+	}
+	for (auto &e: extra_env) {
+		envp.push_back(e.data());
+	}
+	envp.push_back(nullptr);
+
+	const char *argv[] = { "/bin/sh", "-c", rules_.exec.c_str(), nullptr };
+
+	/* do not wait for the command -- it is reaped on the next evaluation */
+	pid_t pid;
+	int err = posix_spawn(&pid, "/bin/sh", nullptr, nullptr, const_cast<char **>(argv), envp.data());
+	if (err) {
+		fmt::print(stderr, "Failed to run alert command: {}\n", std::strerror(err));
+		return;
+	}
+	children_.push_back(pid);
+}
+
+void Alerts::notify_fifo(const std::string &line)
+{
+	/* open lazily and without blocking: with no reader attached the alert is dropped */
+	if (fifo_fd_ < 0) {
+		fifo_fd_ = open(rules_.fifo.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fifo_fd_ < 0) {
+			fmt::print(stderr, "Failed to open alert FIFO {}: {}\n", rules_.fifo, std::strerror(errno));
+			return;
+		}
+	}
+
+	if (write(fifo_fd_, line.data(), line.size()) < 0) {
+		int err = errno;
+		fmt::print(stderr, "Failed to write to alert FIFO {}: {}\n", rules_.fifo, std::strerror(err));
+		if (err == EPIPE) {
+			close(fifo_fd_);
+			fifo_fd_ = -1;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "energy.hpp"
+
+struct StateReader;
+struct StateWriter;
+
+struct AlertRules
+{
+	/* instantaneous power above `power_above` W for at least `power_for` */
+	std::optional<double> power_above;
+	fp_seconds power_for{};
+	/* energy accounted within a single local day above `daily_budget_kwh` */
+	std::optional<double> daily_budget_kwh;
+	/* any rollover or power loss event */
+	bool rollover = false;
+
+	/* where to deliver alerts: a shell command and/or a FIFO */
+	std::string exec;
+	std::filesystem::path fifo;
+
+	bool empty() const
+	{
+		return !power_above && !daily_budget_kwh && !rollover;
+	}
+};
+
+/*
+ * Evaluates alert rules incrementally, once per measurement, after the
+ * measurement has been fed into the accumulator.
+ *
+ * State is tracked from the very first measurement, but nothing is fired
+ * until arm() is called -- this way replaying the existing part of a log
+ * in follow mode does not fire alerts for historic events.
+ */
+class Alerts
+{
+public:
+	Alerts(AlertRules rules, std::string source);
+	~Alerts();
+
+	Alerts(const Alerts &) = delete;
+	Alerts &operator=(const Alerts &) = delete;
+
+	void arm() { armed_ = true; }
+	void evaluate(const Result &r, const Measurement &m);
+
+	/* what evaluate() keeps track of, for FollowSnapshot */
+	void save(StateWriter &w) const;
+	void restore(StateReader &r);
+
+private:
+	void fire(std::string_view kind, const Measurement &m, const std::string &message);
+	void notify_exec(std::string_view kind, const Measurement &m, const std::string &message);
+	void notify_fifo(const std::string &line);
+	void reap();
+
+	AlertRules rules_;
+	std::string source_;
+	bool armed_ = false;
+
+	std::optional<ts_time> power_above_since_;
+	bool power_fired_ = false;
+
+	std::chrono::local_days day_{};
+	double day_energy_j_ = 0;
+	double last_energy_j_ = 0;
+	bool budget_fired_ = false;
+
+	unsigned rollovers_ = 0;
+	unsigned power_losses_ = 0;
+
+	int fifo_fd_ = -1;
+	/* alert commands that have not been reaped yet */
+	std::vector<pid_t> children_;
+};
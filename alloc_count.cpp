@@ -0,0 +1,45 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "alloc_count.hpp"
+
+static std::atomic<size_t> allocations{0};
+
+size_t allocation_count()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+static void *counted_alloc(size_t size, size_t align = __STDCPP_DEFAULT_NEW_ALIGNMENT__) noexcept
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		return std::aligned_alloc(align, (size + align - 1) / align * align);
+	}
+	return std::malloc(size ? size : 1);
+}
+
+static void *checked(void *p)
+{
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new(size_t size) { return checked(counted_alloc(size)); }
+void *operator new[](size_t size) { return checked(counted_alloc(size)); }
+void *operator new(size_t size, std::align_val_t align) { return checked(counted_alloc(size, size_t(align))); }
+void *operator new[](size_t size, std::align_val_t align) { return checked(counted_alloc(size, size_t(align))); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * Number of heap allocations made so far, for checking that hot loops do
+ * not allocate. Only built with LIQUIDCTL_ENERGY_COUNT_ALLOCATIONS, as it
+ * replaces the global operator new.
+ */
+size_t allocation_count();
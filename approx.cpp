@@ -0,0 +1,149 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "approx.hpp"
+#include "measurements.hpp"
+
+static const constexpr size_t BLOCK_SIZE = 1 << 20;
+
+/* two-sided 95% quantile of Student's t distribution with `df` degrees of freedom */
+static double t_95(size_t df)
+{
+	static const double t[] = {
+		12.71, 4.30, 3.18, 2.78, 2.57, 2.45, 2.36, 2.31, 2.26, 2.23,
+		2.20, 2.18, 2.16, 2.14, 2.13, 2.12, 2.11, 2.10, 2.09, 2.09,
+		2.08, 2.07, 2.07, 2.06, 2.06, 2.06, 2.05, 2.05, 2.05, 2.04,
+	};
+	/* close enough to the normal distribution's from there on */
+	return df <= std::size(t) ? t[df - 1] : 1.96;
+}
+
+/* the start of the first line at or after `offset` */
+static size_t line_start(std::string_view data, size_t offset)
+{
+	if (offset == 0) {
+		return 0;
+	}
+	size_t eol = data.find('\n', offset - 1);
+	return eol == data.npos ? data.size() : eol + 1;
+}
+
+/* a sum over `n` of `blocks` with these per-block values, scaled up to all of them */
+static Estimate estimate(const std::vector<double> &values, uint64_t blocks)
+{
+	double n = values.size(), sum = 0;
+	for (double v: values) {
+		sum += v;
+	}
+	if (!n) {
+		return {};
+	}
+	double mean = sum / n;
+
+	/* without a spread to go by, there is no telling */
+	double margin = std::numeric_limits<double>::infinity();
+	if (n == blocks) {
+		margin = 0;
+	} else if (n > 1) {
+		double ss = 0;
+		for (double v: values) {
+			ss += (v - mean) * (v - mean);
+		}
+		double variance = blocks * blocks * (1 - n / blocks) * ss / (n - 1) / n;
+		margin = t_95(n - 1) * std::sqrt(variance);
+	}
+	return {mean * blocks, margin};
+}
+
+ApproxResult approx_log(const std::filesystem::path &log, unsigned k, sj::parser &parser, const MemoryBudget &budget)
+{
+	int fd = open(log.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", log));
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), fmt::format("Failed to stat {}", log));
+	}
+	size_t size = st.st_size;
+	const char *map = nullptr;
+	if (size) {
+		void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) {
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(), fmt::format("Failed to map {}", log));
+		}
+		map = static_cast<const char *>(m);
+		/* no read-ahead into the blocks that are skipped */
+		madvise(m, size, MADV_RANDOM);
+	}
+	close(fd);
+
+	ApproxResult ret;
+	std::string_view data(map, size);
+	ret.blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	std::vector<double> energy, time;
+	std::string buf;
+	try {
+		for (uint64_t i = 0; i < ret.blocks; i += k) {
+			size_t begin = line_start(data, i * BLOCK_SIZE);
+			size_t end = line_start(data, std::min((i + 1) * BLOCK_SIZE, size));
+			/* and the first line of the next block, to integrate up to */
+			size_t next = std::min(line_start(data, end + 1), size);
+			if (begin < next) {
+				/* page aligned, and the block is read anyway */
+				size_t aligned = begin & ~size_t(sysconf(_SC_PAGESIZE) - 1);
+				madvise(const_cast<char *>(map) + aligned, next - aligned, MADV_WILLNEED);
+			}
+
+			/* padded for simdjson */
+			buf.assign(data.substr(begin, next - begin));
+			buf.append(simdjson::SIMDJSON_PADDING, '\0');
+			PaddedBuffer source(std::string_view(buf.data(), next - begin));
+
+			Accumulator acc;
+			acc.quiet = true;
+			Measurements measurements(source, parser, true, budget.batch_size);
+			for (const auto &m: measurements) {
+				acc.feed(m);
+			}
+
+			++ret.sampled;
+			ret.docs += measurements.docs();
+			ret.bytes += next - begin;
+			ret.bad |= acc.r.bad;
+			energy.push_back(acc.r.total.energy_j);
+			time.push_back(acc.r.total.time.count());
+		}
+	} catch (...) {
+		if (map) {
+			munmap(const_cast<char *>(map), size);
+		}
+		throw;
+	}
+	if (map) {
+		munmap(const_cast<char *>(map), size);
+	}
+
+	ret.energy_j = estimate(energy, ret.blocks);
+	ret.time_s = estimate(time, ret.blocks);
+	return ret;
+}
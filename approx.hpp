@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "budget.hpp"
+#include "energy.hpp"
+
+/* a total, give or take `margin` at 95% confidence */
+struct Estimate
+{
+	double value = 0, margin = 0;
+};
+
+struct ApproxResult
+{
+	/* blocks of the log, and how many of them were read */
+	uint64_t blocks = 0, sampled = 0;
+	uint64_t docs = 0, bytes = 0;
+	Estimate energy_j, time_s;
+	bool bad = false;
+};
+
+/*
+ * Totals of a log estimated from every `k`-th block of it, for a quick
+ * look at logs too large to go through in full. Only the sampled blocks
+ * are read at all.
+ *
+ * Blocks are BLOCK_SIZE bytes apart, each starting at the first line at
+ * or after its offset. A block is integrated on its own, up to the first
+ * measurement of the next one, so that the blocks split the steps of the
+ * log between them. Totals are the sampled blocks' sums scaled up to all
+ * blocks; their margins treat the sample as a simple random one (with
+ * Student's t for few blocks), which overstates them where the power
+ * drifts slowly.
+ */
+ApproxResult approx_log(const std::filesystem::path &log, unsigned k, sj::parser &parser, const MemoryBudget &budget = {});
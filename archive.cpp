@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cerrno>
+#include <concepts>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "archive.hpp"
+#include "hash.hpp"
+#include "input.hpp"
+#include "parallel.hpp"
+
+/* from contrib/seekable_format/zstd_seekable_compression_format.md */
+static const uint32_t SKIPPABLE_MAGIC = 0x184D2A50;
+static const uint32_t SEEK_TABLE_MAGIC = SKIPPABLE_MAGIC | 0xE;
+static const uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+static const uint8_t SEEK_TABLE_CHECKSUMS = 0x80;
+static const size_t SEEK_TABLE_FOOTER = 9;
+
+/* the timestamp index, a skippable frame of its own */
+static const uint32_t INDEX_MAGIC = SKIPPABLE_MAGIC | 0xA;
+static const char MAGIC[8] = {'L', 'C', 'E', 'I', 'N', 'D', 'E', 'X'};
+/* bump whenever the format changes */
+static const uint32_t VERSION = 1;
+
+/* the zstd format is little-endian throughout */
+template<std::integral T>
+static void put_le(std::string &out, T v)
+{
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		out += char(std::make_unsigned_t<T>(v) >> (8 * i));
+	}
+}
+
+template<std::integral T>
+static T get_le(const char *p)
+{
+	std::make_unsigned_t<T> v = 0;
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		v |= std::make_unsigned_t<T>(uint8_t(p[i])) << (8 * i);
+	}
+	return T(v);
+}
+
+static void check_zstd(size_t r, std::string_view what)
+{
+	if (ZSTD_isError(r)) {
+		throw std::runtime_error(fmt::format("{}: {}", what, ZSTD_getErrorName(r)));
+	}
+}
+
+ArchiveWriter::ArchiveWriter(std::filesystem::path path, int level)
+	: path_(std::move(path))
+	, tmp_path_(path_.native() + ".tmp")
+	, cctx_(ZSTD_createCCtx())
+{
+	if (!cctx_) {
+		throw std::bad_alloc();
+	}
+	try {
+		check_zstd(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level), "Invalid compression level");
+		/* for `zstd -t`, the seek table checksums are only checked by seekable readers */
+		check_zstd(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 1), "Failed to set up compression");
+	} catch (...) {
+		ZSTD_freeCCtx(cctx_);
+		throw;
+	}
+
+	fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd_ < 0) {
+		ZSTD_freeCCtx(cctx_);
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to create {}", tmp_path_));
+	}
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+	if (fd_ >= 0) {
+		close(fd_);
+		unlink(tmp_path_.c_str());
+	}
+	ZSTD_freeCCtx(cctx_);
+}
+
+void ArchiveWriter::write(std::string_view data)
+{
+	for (const char *p = data.data(), *end = p + data.size(); p < end; ) {
+		ssize_t r = ::write(fd_, p, end - p);
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", tmp_path_));
+		}
+		p += r;
+		offset_ += r;
+	}
+}
+
+void ArchiveWriter::append(std::string_view raw, ts_time min_ts, ts_time max_ts)
+{
+	if (raw.size() > UINT32_MAX) {
+		throw std::runtime_error(fmt::format("Frame of {} bytes is too large for a seek table", raw.size()));
+	}
+
+	buf_.resize(ZSTD_compressBound(raw.size()));
+	size_t size = ZSTD_compress2(cctx_, buf_.data(), buf_.size(), raw.data(), raw.size());
+	check_zstd(size, fmt::format("Failed to compress into {}", tmp_path_));
+
+	frames_.push_back({
+		.offset = offset_,
+		.size = uint32_t(size),
+		.raw_size = uint32_t(raw.size()),
+		.checksum = uint32_t(xxh64(raw)),
+		.min_ts = min_ts,
+		.max_ts = max_ts,
+	});
+	write(std::string_view(buf_.data(), size));
+}
+
+void ArchiveWriter::finish()
+{
+	std::string out;
+
+	put_le<uint32_t>(out, INDEX_MAGIC);
+	put_le<uint32_t>(out, sizeof(MAGIC) + sizeof(uint32_t) + 16 * frames_.size());
+	out.append(MAGIC, sizeof(MAGIC));
+	put_le<uint32_t>(out, VERSION);
+	for (const auto &f: frames_) {
+		put_le<int64_t>(out, f.min_ts.time_since_epoch().count());
+		put_le<int64_t>(out, f.max_ts.time_since_epoch().count());
+	}
+
+	put_le<uint32_t>(out, SEEK_TABLE_MAGIC);
+	put_le<uint32_t>(out, 12 * frames_.size() + SEEK_TABLE_FOOTER);
+	for (const auto &f: frames_) {
+		put_le<uint32_t>(out, f.size);
+		put_le<uint32_t>(out, f.raw_size);
+		put_le<uint32_t>(out, f.checksum);
+	}
+	put_le<uint32_t>(out, frames_.size());
+	put_le<uint8_t>(out, SEEK_TABLE_CHECKSUMS);
+	put_le<uint32_t>(out, SEEKABLE_MAGIC);
+	write(out);
+
+	if (close(std::exchange(fd_, -1)) < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", tmp_path_));
+	}
+	std::filesystem::rename(tmp_path_, path_);
+}
+
+std::vector<ArchiveFrame> archive_log(const std::filesystem::path &log, const std::filesystem::path &out, int level, size_t frame_size)
+{
+	ArchiveWriter writer(out, level);
+
+	sj::parser parser;
+	InputWindows input(log, frame_size);
+	for (auto w = input.next(); !w.data.empty(); w = input.next()) {
+		ts_time min_ts = ts_time::max(), max_ts = ts_time::min();
+		/* broken documents go into the archive all the same, only without a timestamp */
+		DocumentCursor cursor(parser, w.data, true);
+		auto feed = [&](sj::document_reference doc) {
+			ts_time ts;
+			try {
+				ts = parse_timestamp_fast(doc.find_field("timestamp").get_string());
+			} catch (const std::ios_base::failure &) {
+				return;
+			}
+			min_ts = std::min(min_ts, ts);
+			max_ts = std::max(max_ts, ts);
+		};
+		while (cursor.next(feed)) {
+		}
+		writer.append(w.data, min_ts, max_ts);
+	}
+	writer.finish();
+	return writer.frames();
+}
+
+ArchiveReader::ArchiveReader(const std::filesystem::path &path)
+	: path_(path)
+{
+	int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", path_));
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), fmt::format("Failed to stat {}", path_));
+	}
+	size_ = st.st_size;
+	if (size_) {
+		void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(), fmt::format("Failed to map {}", path_));
+		}
+		map_ = static_cast<const char *>(map);
+	}
+	close(fd);
+
+	auto invalid = [&](std::string_view why) {
+		return std::runtime_error(fmt::format("{} is not a seekable zstd archive ({})", path_, why));
+	};
+	if (size_ < 8 + SEEK_TABLE_FOOTER || get_le<uint32_t>(map_ + size_ - 4) != SEEKABLE_MAGIC) {
+		throw invalid("no seek table");
+	}
+
+	uint32_t n = get_le<uint32_t>(map_ + size_ - SEEK_TABLE_FOOTER);
+	uint8_t descriptor = map_[size_ - 5];
+	if (descriptor & 0x7f) {
+		throw invalid("reserved bits set");
+	}
+	bool checksums = descriptor & SEEK_TABLE_CHECKSUMS;
+	size_t entry = checksums ? 12 : 8;
+	if ((size_ - 8 - SEEK_TABLE_FOOTER) / entry < n) {
+		throw invalid("truncated seek table");
+	}
+	size_t table = size_ - 8 - SEEK_TABLE_FOOTER - entry * n;
+	if (get_le<uint32_t>(map_ + table) != SEEK_TABLE_MAGIC
+	    || get_le<uint32_t>(map_ + table + 4) != entry * n + SEEK_TABLE_FOOTER) {
+		throw invalid("bad seek table header");
+	}
+
+	uint64_t offset = 0;
+	for (const char *p = map_ + table + 8; frames_.size() < n; p += entry) {
+		ArchiveFrame f{
+			.offset = offset,
+			.size = get_le<uint32_t>(p),
+			.raw_size = get_le<uint32_t>(p + 4),
+			.checksum = checksums ? get_le<uint32_t>(p + 8) : 0,
+		};
+		/* without timestamps, a frame may hold any */
+		f.min_ts = ts_time::min();
+		f.max_ts = ts_time::max();
+		offset += f.size;
+		if (offset > table) {
+			throw invalid("frames past the seek table");
+		}
+		frames_.push_back(f);
+	}
+	checksums_ = checksums;
+
+	/* the timestamp index, if any, is all there is between the frames and the seek table */
+	size_t index_size = 8 + sizeof(MAGIC) + sizeof(uint32_t) + 16 * size_t(n);
+	if (table - offset == index_size
+	    && get_le<uint32_t>(map_ + offset) == INDEX_MAGIC
+	    && get_le<uint32_t>(map_ + offset + 4) == index_size - 8
+	    && std::string_view(map_ + offset + 8, sizeof(MAGIC)) == std::string_view(MAGIC, sizeof(MAGIC))) {
+		uint32_t version = get_le<uint32_t>(map_ + offset + 8 + sizeof(MAGIC));
+		if (version != VERSION) {
+			throw invalid(fmt::format("timestamp index version {}", version));
+		}
+		const char *p = map_ + offset + 8 + sizeof(MAGIC) + sizeof(uint32_t);
+		for (auto &f: frames_) {
+			f.min_ts = ts_time{ts_time::duration{get_le<int64_t>(p)}};
+			f.max_ts = ts_time{ts_time::duration{get_le<int64_t>(p + 8)}};
+			p += 16;
+		}
+		indexed_ = true;
+	}
+}
+
+ArchiveReader::~ArchiveReader()
+{
+	if (map_) {
+		munmap(const_cast<char *>(map_), size_);
+	}
+}
+
+std::string ArchiveReader::decompress(const ArchiveFrame &f) const
+{
+	size_t index = &f - frames_.data();
+	std::string raw(f.raw_size + simdjson::SIMDJSON_PADDING, '\0');
+	size_t size = ZSTD_decompress(raw.data(), f.raw_size, map_ + f.offset, f.size);
+	check_zstd(size, fmt::format("Failed to decompress frame {} of {}", index, path_));
+	if (size != f.raw_size) {
+		throw std::runtime_error(fmt::format("Frame {} of {} is {} bytes, not {}", index, path_, size, f.raw_size));
+	}
+	if (checksums_ && uint32_t(xxh64(std::string_view(raw.data(), size))) != f.checksum) {
+		throw std::runtime_error(fmt::format("Checksum mismatch in frame {} of {}", index, path_));
+	}
+	return raw;
+}
+
+/* the lines of `raw` (padded) with timestamps in [since, until) */
+static std::string filter_lines(sj::parser &parser, std::string_view raw, ts_time since, ts_time until)
+{
+	std::string out;
+	for (size_t offset = 0; offset < raw.size(); ) {
+		size_t eol = std::min(raw.find('\n', offset), raw.size());
+		std::string_view line = raw.substr(offset, eol - offset);
+		offset = eol + 1;
+
+		/* the rest of the frame is readable padding as far as simdjson is concerned */
+		sj::document doc;
+		size_t capacity = raw.size() - (line.data() - raw.data()) + simdjson::SIMDJSON_PADDING;
+		std::string_view stamp;
+		if (parser.iterate(line.data(), line.size(), capacity).get(doc)
+		    || doc.find_field("timestamp").get_string().get(stamp)) {
+			continue;
+		}
+		ts_time ts;
+		try {
+			ts = parse_timestamp_fast(stamp);
+		} catch (const std::ios_base::failure &) {
+			continue;
+		}
+		if (ts >= since && ts < until) {
+			out.append(line);
+			out += '\n';
+		}
+	}
+	return out;
+}
+
+void ArchiveReader::extract(ts_time since, ts_time until, unsigned threads, std::FILE *out, Scan &scan) const
+{
+	bool ranged = since != ts_time::min() || until != ts_time::max();
+
+	std::vector<const ArchiveFrame *> wanted;
+	for (const auto &f: frames_) {
+		if (ranged && (f.max_ts < since || f.min_ts >= until)) {
+			++scan.skipped;
+		} else {
+			wanted.push_back(&f);
+		}
+	}
+
+	/* a few frames a thread at a time, to keep them in order with bounded memory */
+	size_t batch = std::max(threads, 1u) * 4;
+	std::vector<std::string> chunks(batch);
+	std::vector<std::string_view> views(batch);
+	std::vector<char> whole(batch);
+	for (size_t first = 0; first < wanted.size(); first += batch) {
+		size_t n = std::min(batch, wanted.size() - first);
+		parallel_for(n, threads, [&](size_t i) {
+			thread_local sj::parser parser;
+			const ArchiveFrame &f = *wanted[first + i];
+			chunks[i] = decompress(f);
+			std::string_view raw(chunks[i].data(), f.raw_size);
+			whole[i] = !ranged || (f.min_ts >= since && f.max_ts < until);
+			if (whole[i]) {
+				views[i] = raw;
+			} else {
+				chunks[i] = filter_lines(parser, raw, since, until);
+				views[i] = chunks[i];
+			}
+		});
+
+		for (size_t i = 0; i < n; ++i) {
+			++(whole[i] ? scan.whole : scan.filtered);
+			scan.bytes += views[i].size();
+			if (std::fwrite(views[i].data(), 1, views[i].size(), out) != views[i].size()) {
+				throw std::system_error(errno, std::generic_category(), "Failed to write out lines");
+			}
+		}
+	}
+}
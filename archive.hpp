@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zstd.h>
+
+#include "energy.hpp"
+
+/*
+ * Raw logs, compressed for keeping them around for audits, in the
+ * seekable zstd format (zstd's contrib/seekable_format): independent
+ * frames of whole lines, then a seek table of their sizes in a skippable
+ * frame at the end. `zstd -d` still restores the log as it was.
+ *
+ * Just before the seek table, another skippable frame keeps the earliest
+ * and the latest timestamp of each frame, so that a reader only
+ * decompresses the frames that overlap the span of time it is after.
+ */
+struct ArchiveFrame
+{
+	uint64_t offset;
+	uint32_t size, raw_size;
+	/* low 32 bits of the XXH64 of the raw frame, as the seek table has it */
+	uint32_t checksum;
+	/* of the good documents; min_ts > max_ts if there are none */
+	ts_time min_ts = ts_time::max(), max_ts = ts_time::min();
+};
+
+/* written under a temporary name and only renamed into place by finish() */
+class ArchiveWriter
+{
+public:
+	ArchiveWriter(std::filesystem::path path, int level);
+	~ArchiveWriter();
+
+	ArchiveWriter(const ArchiveWriter &) = delete;
+	ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+	/* a frame of whole lines, with the timestamps in it */
+	void append(std::string_view raw, ts_time min_ts, ts_time max_ts);
+	void finish();
+
+	const std::vector<ArchiveFrame> &frames() const { return frames_; }
+
+private:
+	void write(std::string_view data);
+
+	std::filesystem::path path_, tmp_path_;
+	int fd_ = -1;
+	ZSTD_CCtx *cctx_;
+	uint64_t offset_ = 0;
+	std::string buf_;
+	std::vector<ArchiveFrame> frames_;
+};
+
+/*
+ * Archives `log` into `out`, a frame per input window of about
+ * `frame_size` bytes (see InputWindows). Returns the frames.
+ */
+std::vector<ArchiveFrame> archive_log(const std::filesystem::path &log, const std::filesystem::path &out, int level, size_t frame_size);
+
+/*
+ * Maps the whole file; throws std::runtime_error if it has no seek table.
+ * Archives of other seekable zstd writers have no timestamps: each of
+ * their frames may hold any.
+ */
+class ArchiveReader
+{
+public:
+	explicit ArchiveReader(const std::filesystem::path &path);
+	~ArchiveReader();
+
+	ArchiveReader(const ArchiveReader &) = delete;
+	ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+	const std::vector<ArchiveFrame> &frames() const { return frames_; }
+	bool indexed() const { return indexed_; }
+
+	/* the raw frame, padded for simdjson; throws on a checksum mismatch */
+	std::string decompress(const ArchiveFrame &f) const;
+
+	/* how an extraction got at the frames */
+	struct Scan
+	{
+		size_t skipped = 0, whole = 0, filtered = 0;
+		uint64_t bytes = 0;
+	};
+
+	/*
+	 * Writes the lines with timestamps in [since, until) to `out`, in
+	 * order, decompressing the frames on up to `threads` threads. Frames
+	 * wholly inside the range are written as they are; on its edges, lines
+	 * without a timestamp are left out. Without a range, all of the log
+	 * is written.
+	 */
+	void extract(ts_time since, ts_time until, unsigned threads, std::FILE *out, Scan &scan) const;
+
+private:
+	std::filesystem::path path_;
+	const char *map_ = nullptr;
+	size_t size_ = 0;
+	bool indexed_ = false, checksums_ = false;
+	std::vector<ArchiveFrame> frames_;
+};
@@ -0,0 +1,499 @@
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "arrow.hpp"
+
+static_assert(std::endian::native == std::endian::little, "Arrow data is written as is, in little-endian order");
+
+namespace {
+
+/*
+ * Just enough of FlatBuffers to write Arrow metadata (see Schema.fbs,
+ * Message.fbs and File.fbs in the Arrow format specification).
+ *
+ * Objects are laid out front to back: a table is written with
+ * placeholders in its offset fields, which are linked to the objects
+ * written after it (offsets always point forward).
+ */
+class FlatBuffer
+{
+public:
+	/* a table field, by slot; a default-constructed one is absent */
+	struct Field
+	{
+		size_t size = 0;
+		uint64_t value = 0;
+	};
+
+	static Field u8(uint8_t v) { return {1, v}; }
+	static Field i16(int16_t v) { return {2, uint16_t(v)}; }
+	static Field i32(int32_t v) { return {4, uint32_t(v)}; }
+	static Field i64(int64_t v) { return {8, uint64_t(v)}; }
+	static Field boolean(bool v) { return {1, v}; }
+	/* to be link()ed */
+	static Field offset() { return {4, 0}; }
+
+	struct Table
+	{
+		size_t pos;
+		/* positions of the fields, by slot */
+		std::vector<size_t> slot;
+	};
+
+	FlatBuffer()
+	{
+		/* root offset */
+		put<uint32_t>(0);
+	}
+
+	Table table(std::initializer_list<Field> fields)
+	{
+		/* inline layout: the vtable offset, then the fields from the widest down, each aligned */
+		std::vector<uint16_t> vtable(fields.size());
+		size_t table_size = 4, align = 4;
+		for (size_t size: {8, 4, 2, 1}) {
+			for (size_t i = 0; i < fields.size(); ++i) {
+				if (fields.begin()[i].size == size) {
+					table_size = (table_size + size - 1) / size * size;
+					vtable[i] = table_size;
+					table_size += size;
+					align = std::max(align, size);
+				}
+			}
+		}
+
+		pad(2);
+		size_t vtable_pos = buf_.size();
+		put<uint16_t>(4 + 2 * vtable.size());
+		put<uint16_t>(table_size);
+		for (uint16_t off: vtable) {
+			put<uint16_t>(off);
+		}
+
+		pad(align);
+		Table t{buf_.size(), std::vector<size_t>(fields.size())};
+		buf_.resize(buf_.size() + table_size);
+		store<int32_t>(t.pos, t.pos - vtable_pos);
+		for (size_t i = 0; i < fields.size(); ++i) {
+			const Field &f = fields.begin()[i];
+			if (f.size) {
+				t.slot[i] = t.pos + vtable[i];
+				std::memcpy(&buf_[t.slot[i]], &f.value, f.size);
+			}
+		}
+		return t;
+	}
+
+	size_t string(std::string_view s)
+	{
+		pad(4);
+		size_t pos = buf_.size();
+		put<uint32_t>(s.size());
+		buf_.append(s);
+		buf_.push_back('\0');
+		return pos;
+	}
+
+	/* a vector of structs, each `size` bytes and aligned to `align` */
+	size_t structs(const void *data, size_t count, size_t size, size_t align)
+	{
+		pad(4);
+		while ((buf_.size() + 4) % align) {
+			buf_.push_back('\0');
+		}
+		size_t pos = buf_.size();
+		put<uint32_t>(count);
+		buf_.append(static_cast<const char *>(data), count * size);
+		return pos;
+	}
+
+	/* a vector of `count` offsets, the i-th of which is at element(pos, i) */
+	size_t offsets(size_t count)
+	{
+		pad(4);
+		size_t pos = buf_.size();
+		put<uint32_t>(count);
+		buf_.resize(buf_.size() + 4 * count);
+		return pos;
+	}
+
+	static size_t element(size_t vector_pos, size_t i)
+	{
+		return vector_pos + 4 + 4 * i;
+	}
+
+	void link(size_t field_pos, size_t target_pos)
+	{
+		store<uint32_t>(field_pos, target_pos - field_pos);
+	}
+
+	/* sets the root table and pads the buffer to a multiple of 8 bytes */
+	std::string finish(size_t root_pos)
+	{
+		link(0, root_pos);
+		pad(8);
+		return std::move(buf_);
+	}
+
+private:
+	void pad(size_t align)
+	{
+		buf_.resize((buf_.size() + align - 1) / align * align);
+	}
+
+	template<typename T>
+	void put(T v)
+	{
+		buf_.append(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+
+	template<typename T>
+	void store(size_t pos, T v)
+	{
+		std::memcpy(&buf_[pos], &v, sizeof(v));
+	}
+
+	std::string buf_;
+};
+
+using FB = FlatBuffer;
+
+/* MetadataVersion.V5 */
+const int16_t VERSION = 4;
+
+/* MessageHeader */
+const uint8_t HEADER_SCHEMA = 1;
+const uint8_t HEADER_DICTIONARY_BATCH = 2;
+const uint8_t HEADER_RECORD_BATCH = 3;
+
+/* Type */
+const uint8_t TYPE_INT = 2;
+const uint8_t TYPE_FLOATING_POINT = 3;
+const uint8_t TYPE_UTF8 = 5;
+const uint8_t TYPE_TIMESTAMP = 10;
+
+/* padded to 8 bytes at the start of the file */
+const char MAGIC[8] = "ARROW1";
+
+struct FieldNode
+{
+	int64_t length;
+	int64_t null_count;
+};
+
+struct Buffer
+{
+	int64_t offset;
+	int64_t length;
+};
+
+/* the structs are written as is, so their layout has to match the schema */
+static_assert(sizeof(FieldNode) == 16 && sizeof(Buffer) == 16);
+
+size_t width(ArrowType type)
+{
+	return type == ArrowType::INT32 || type == ArrowType::DICTIONARY ? 4 : 8;
+}
+
+size_t int_type(FB &fb, int32_t bits)
+{
+	return fb.table({FB::i32(bits), FB::boolean(true)}).pos;
+}
+
+size_t field(FB &fb, const ArrowColumn &column)
+{
+	uint8_t type_type = 0;
+	switch (column.type) {
+	case ArrowType::INT32: type_type = TYPE_INT; break;
+	case ArrowType::FLOAT64: type_type = TYPE_FLOATING_POINT; break;
+	case ArrowType::TIMESTAMP: type_type = TYPE_TIMESTAMP; break;
+	/* the type of a dictionary-encoded field is that of its values */
+	case ArrowType::DICTIONARY: type_type = TYPE_UTF8; break;
+	}
+	bool dictionary = column.type == ArrowType::DICTIONARY;
+
+	/* name, nullable, type_type, type, dictionary, children */
+	auto f = fb.table({
+		FB::offset(),
+		FB::boolean(false),
+		FB::u8(type_type),
+		FB::offset(),
+		dictionary ? FB::offset() : FB::Field{},
+		FB::offset(),
+	});
+	fb.link(f.slot[0], fb.string(column.name));
+
+	switch (column.type) {
+	case ArrowType::INT32:
+		fb.link(f.slot[3], int_type(fb, 32));
+		break;
+	case ArrowType::FLOAT64:
+		/* precision: DOUBLE */
+		fb.link(f.slot[3], fb.table({FB::i16(2)}).pos);
+		break;
+	case ArrowType::TIMESTAMP: {
+		/* unit: NANOSECOND, timezone */
+		auto t = fb.table({FB::i16(3), FB::offset()});
+		fb.link(f.slot[3], t.pos);
+		fb.link(t.slot[1], fb.string("UTC"));
+		break;
+	}
+	case ArrowType::DICTIONARY: {
+		fb.link(f.slot[3], fb.table({}).pos);
+		/* id, indexType, isOrdered */
+		auto d = fb.table({FB::i64(0), FB::offset(), FB::boolean(false)});
+		fb.link(f.slot[4], d.pos);
+		fb.link(d.slot[1], int_type(fb, 32));
+		break;
+	}
+	}
+
+	/* readers insist on the vector, even if empty */
+	fb.link(f.slot[5], fb.offsets(0));
+	return f.pos;
+}
+
+size_t schema(FB &fb, const std::vector<ArrowColumn> &columns)
+{
+	/* endianness: Little, fields */
+	auto s = fb.table({FB::i16(0), FB::offset()});
+	size_t fields = fb.offsets(columns.size());
+	fb.link(s.slot[1], fields);
+	for (size_t i = 0; i < columns.size(); ++i) {
+		fb.link(FB::element(fields, i), field(fb, columns[i]));
+	}
+	return s.pos;
+}
+
+size_t record_batch(FB &fb, int64_t length, const std::vector<FieldNode> &nodes, const std::vector<Buffer> &buffers)
+{
+	/* length, nodes, buffers */
+	auto rb = fb.table({FB::i64(length), FB::offset(), FB::offset()});
+	fb.link(rb.slot[1], fb.structs(nodes.data(), nodes.size(), sizeof(FieldNode), 8));
+	fb.link(rb.slot[2], fb.structs(buffers.data(), buffers.size(), sizeof(Buffer), 8));
+	return rb.pos;
+}
+
+/* appends a buffer to a message body, 8-byte aligned as the format requires */
+void add_buffer(std::string &body, std::vector<Buffer> &buffers, std::string_view data)
+{
+	buffers.push_back({int64_t(body.size()), int64_t(data.size())});
+	body.append(data);
+	body.resize((body.size() + 7) / 8 * 8);
+}
+
+} // namespace
+
+ArrowWriter::ArrowWriter(std::filesystem::path path,
+			 std::vector<ArrowColumn> columns,
+			 std::vector<std::string> dictionary,
+			 size_t batch_rows)
+	: path_(std::move(path))
+	, tmp_path_(path_.native() + ".tmp")
+	, columns_(std::move(columns))
+	, dictionary_(std::move(dictionary))
+	, batch_rows_(batch_rows)
+	, data_(columns_.size())
+{
+	fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd_ < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to create {}", tmp_path_));
+	}
+
+	try {
+		start();
+	} catch (...) {
+		close(fd_);
+		unlink(tmp_path_.c_str());
+		throw;
+	}
+}
+
+void ArrowWriter::start()
+{
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		data_[i].reserve(batch_rows_ * width(columns_[i].type));
+	}
+
+	write(MAGIC, 8);
+	write_message(HEADER_SCHEMA, {}, [&](FB &fb) {
+		return schema(fb, columns_);
+	});
+
+	if (std::any_of(columns_.begin(), columns_.end(), [](const ArrowColumn &c) { return c.type == ArrowType::DICTIONARY; })) {
+		/* utf8 values: validity, offsets, data */
+		std::string offsets, values;
+		for (const auto &s: dictionary_) {
+			int32_t off = values.size();
+			offsets.append(reinterpret_cast<const char *>(&off), sizeof(off));
+			values.append(s);
+		}
+		int32_t end = values.size();
+		offsets.append(reinterpret_cast<const char *>(&end), sizeof(end));
+
+		std::string body;
+		std::vector<Buffer> buffers;
+		add_buffer(body, buffers, {});
+		add_buffer(body, buffers, offsets);
+		add_buffer(body, buffers, values);
+		std::vector<FieldNode> nodes{{int64_t(dictionary_.size()), 0}};
+
+		dictionary_blocks_.push_back(write_message(HEADER_DICTIONARY_BATCH, body, [&](FB &fb) {
+			/* id, data, isDelta */
+			auto d = fb.table({FB::i64(0), FB::offset(), FB::boolean(false)});
+			fb.link(d.slot[1], record_batch(fb, dictionary_.size(), nodes, buffers));
+			return d.pos;
+		}));
+	}
+}
+
+ArrowWriter::~ArrowWriter()
+{
+	if (fd_ >= 0) {
+		close(fd_);
+		unlink(tmp_path_.c_str());
+	}
+}
+
+void ArrowWriter::write(const void *data, size_t len)
+{
+	for (auto p = static_cast<const char *>(data); len; ) {
+		ssize_t r = ::write(fd_, p, len);
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", tmp_path_));
+		}
+		p += r;
+		len -= r;
+		offset_ += r;
+	}
+}
+
+template<typename F>
+ArrowWriter::Block ArrowWriter::write_message(uint8_t header_type, const std::string &body, F &&header)
+{
+	FB fb;
+	/* version, header_type, header, bodyLength */
+	auto m = fb.table({FB::i16(VERSION), FB::u8(header_type), FB::offset(), FB::i64(body.size())});
+	fb.link(m.slot[2], header(fb));
+	std::string meta = fb.finish(m.pos);
+
+	Block block{offset_, int32_t(8 + meta.size()), int64_t(body.size())};
+	/* continuation marker, metadata size */
+	int32_t prefix[2] = {-1, int32_t(meta.size())};
+	write(prefix, sizeof(prefix));
+	write(meta.data(), meta.size());
+	write(body.data(), body.size());
+	return block;
+}
+
+void ArrowWriter::append(std::initializer_list<ArrowValue> row)
+{
+	if (row.size() != columns_.size()) {
+		throw std::logic_error(fmt::format("{} values for {} columns", row.size(), columns_.size()));
+	}
+
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		const ArrowValue &v = row.begin()[i];
+		if (columns_[i].type == ArrowType::FLOAT64) {
+			double x = v.integral ? double(v.i) : v.d;
+			data_[i].append(reinterpret_cast<const char *>(&x), sizeof(x));
+			continue;
+		}
+
+		/* a double goes into an integer column only if it is in range (which NaN is not) */
+		int64_t x = v.i;
+		if (!v.integral) {
+			if (!(v.d >= -0x1p63 && v.d < 0x1p63)) {
+				throw std::runtime_error(fmt::format("{} does not fit the integer column {}", v.d, columns_[i].name));
+			}
+			x = int64_t(v.d);
+		}
+		if (columns_[i].type == ArrowType::TIMESTAMP) {
+			data_[i].append(reinterpret_cast<const char *>(&x), sizeof(x));
+		} else {
+			int32_t x32 = x;
+			data_[i].append(reinterpret_cast<const char *>(&x32), sizeof(x32));
+		}
+	}
+
+	if (++rows_ == batch_rows_) {
+		flush();
+	}
+}
+
+void ArrowWriter::flush()
+{
+	if (!rows_) {
+		return;
+	}
+
+	std::string body;
+	std::vector<FieldNode> nodes;
+	std::vector<Buffer> buffers;
+	for (auto &d: data_) {
+		nodes.push_back({int64_t(rows_), 0});
+		/* no nulls, no validity bitmap */
+		add_buffer(body, buffers, {});
+		add_buffer(body, buffers, d);
+		d.clear();
+	}
+
+	batch_blocks_.push_back(write_message(HEADER_RECORD_BATCH, body, [&](FB &fb) {
+		return record_batch(fb, rows_, nodes, buffers);
+	}));
+	rows_ = 0;
+}
+
+void ArrowWriter::finish()
+{
+	flush();
+
+	/* end-of-stream marker, then the footer for random access */
+	int32_t eos[2] = {-1, 0};
+	write(eos, sizeof(eos));
+
+	/* Block is a struct of offset, metaDataLength and bodyLength, padded to 24 bytes */
+	auto blocks = [](const std::vector<Block> &v) {
+		std::string out;
+		for (const auto &b: v) {
+			char raw[24] = {};
+			std::memcpy(raw, &b.offset, 8);
+			std::memcpy(raw + 8, &b.meta_length, 4);
+			std::memcpy(raw + 16, &b.body_length, 8);
+			out.append(raw, sizeof(raw));
+		}
+		return out;
+	};
+	std::string dictionaries = blocks(dictionary_blocks_), batches = blocks(batch_blocks_);
+
+	FB fb;
+	/* version, schema, dictionaries, recordBatches */
+	auto f = fb.table({FB::i16(VERSION), FB::offset(), FB::offset(), FB::offset()});
+	fb.link(f.slot[1], schema(fb, columns_));
+	fb.link(f.slot[2], fb.structs(dictionaries.data(), dictionary_blocks_.size(), 24, 8));
+	fb.link(f.slot[3], fb.structs(batches.data(), batch_blocks_.size(), 24, 8));
+	std::string footer = fb.finish(f.pos);
+
+	int32_t footer_size = footer.size();
+	write(footer.data(), footer.size());
+	write(&footer_size, sizeof(footer_size));
+	write(MAGIC, 6);
+
+	if (close(std::exchange(fd_, -1)) < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", tmp_path_));
+	}
+	std::filesystem::rename(tmp_path_, path_);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "energy.hpp"
+
+enum class ArrowType
+{
+	INT32,
+	FLOAT64,
+	/* UTC, ns */
+	TIMESTAMP,
+	/* int32 indices into the string dictionary given to the writer */
+	DICTIONARY,
+};
+
+struct ArrowColumn
+{
+	std::string name;
+	ArrowType type;
+};
+
+/* a cell, converted to the type of its column when it is appended */
+struct ArrowValue
+{
+	ArrowValue(int32_t v): i(v), integral(true) { }
+	ArrowValue(int64_t v): i(v), integral(true) { }
+	ArrowValue(double v): d(v), integral(false) { }
+	ArrowValue(ts_time v): i(v.time_since_epoch().count()), integral(true) { }
+
+	/* whichever `integral` says is set */
+	int64_t i = 0;
+	double d = 0;
+	bool integral;
+};
+
+/*
+ * Writes a table in the Arrow IPC file format (also known as Feather v2),
+ * which pandas, polars, DuckDB and others can memory-map without parsing.
+ *
+ * Rows are buffered per column and written out as a record batch every
+ * `batch_rows` rows, so memory use does not grow with the table. The
+ * file is written under a temporary name and only renamed into place by
+ * finish(), so an interrupted export does not leave a truncated file.
+ *
+ * No nulls, no compression, at most one dictionary (shared by all
+ * DICTIONARY columns, fixed up front).
+ */
+class ArrowWriter
+{
+public:
+	ArrowWriter(std::filesystem::path path,
+		    std::vector<ArrowColumn> columns,
+		    std::vector<std::string> dictionary = {},
+		    size_t batch_rows = 65536);
+	~ArrowWriter();
+
+	ArrowWriter(const ArrowWriter &) = delete;
+	ArrowWriter &operator=(const ArrowWriter &) = delete;
+
+	void append(std::initializer_list<ArrowValue> row);
+	void finish();
+
+private:
+	struct Block
+	{
+		int64_t offset;
+		int32_t meta_length;
+		int64_t body_length;
+	};
+
+	/* writes the schema and the dictionary */
+	void start();
+	void write(const void *data, size_t len);
+	void flush();
+	template<typename F>
+	Block write_message(uint8_t header_type, const std::string &body, F &&header);
+
+	std::filesystem::path path_, tmp_path_;
+	std::vector<ArrowColumn> columns_;
+	std::vector<std::string> dictionary_;
+	size_t batch_rows_;
+
+	int fd_ = -1;
+	int64_t offset_ = 0;
+	size_t rows_ = 0;
+	/* little-endian values of the pending rows, one buffer per column */
+	std::vector<std::string> data_;
+	std::vector<Block> dictionary_blocks_, batch_blocks_;
+};
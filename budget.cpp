@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "budget.hpp"
+
+static const constexpr size_t KiB = 1 << 10, MiB = 1 << 20;
+/* the least fit() makes do with, and the least window a followed log gets */
+static const constexpr size_t MIN_BATCH_SIZE = 64 * KiB;
+
+MemoryBudget MemoryBudget::fit(size_t limit)
+{
+	/* loaded on first use, make it count as resident already */
+	std::chrono::current_zone();
+
+	size_t resident = current_rss();
+	if (limit < resident + 2 * MiB) {
+		throw std::runtime_error(fmt::format(
+			"Memory limit of {:.1f} MB is too low, {:.1f} MB are needed to start with",
+			limit / 1e6,
+			(resident + 2 * MiB) / 1e6
+		));
+	}
+	size_t avail = limit - resident;
+
+	/*
+	 * The parser takes up to ~3 times its batch size (structural indices
+	 * and a string buffer; DocumentCursor does without the stage 1 thread,
+	 * which would double that), the input buffer twice the window. The
+	 * rest is left for the heap to fragment.
+	 */
+	MemoryBudget b;
+	b.batch_size = std::clamp(avail / 32, MIN_BATCH_SIZE, b.batch_size);
+	b.window = 4 * b.batch_size;
+	/* 40 bytes a row at most, twice over while a batch is written out, for each of the two files */
+	b.arrow_rows = std::clamp(avail / 16 / 160, size_t(1024), b.arrow_rows);
+	b.sqlite_cache = avail / 16;
+	return b;
+}
+
+MemoryBudget MemoryBudget::split(size_t n) const
+{
+	MemoryBudget b = *this;
+	b.window = window / std::max(n, size_t(1));
+	if (b.window < MIN_BATCH_SIZE) {
+		throw std::runtime_error(fmt::format(
+			"Memory limit is too low for {} logs, each needs a window of {} KiB at least",
+			n,
+			MIN_BATCH_SIZE / KiB
+		));
+	}
+	return b;
+}
+
+size_t parse_size(std::string_view s)
+{
+	size_t n = 0;
+	auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+	std::string_view suffix(end, s.data() + s.size() - end);
+	size_t unit = suffix == "" ? 1
+		: suffix == "K" || suffix == "k" ? KiB
+		: suffix == "M" || suffix == "m" ? MiB
+		: suffix == "G" || suffix == "g" ? 1024 * MiB
+		: 0;
+	if (ec != std::errc{} || end == s.data() || !unit || n > SIZE_MAX / unit) {
+		throw std::runtime_error(fmt::format("Invalid size: {}", s));
+	}
+	return n * unit;
+}
+
+size_t current_rss()
+{
+	/* resident pages are the second field */
+	FILE *f = std::fopen("/proc/self/statm", "re");
+	if (!f) {
+		throw std::system_error(errno, std::generic_category(), "Failed to open /proc/self/statm");
+	}
+	unsigned long size, resident;
+	int n = std::fscanf(f, "%lu %lu", &size, &resident);
+	std::fclose(f);
+	if (n != 2) {
+		throw std::runtime_error("Failed to parse /proc/self/statm");
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+size_t peak_rss()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	/* in KiB */
+	return ru.ru_maxrss * KiB;
+}
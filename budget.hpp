@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+/*
+ * Sizes of the buffers that memory use grows with. By default they are
+ * sized for throughput; fit() sizes them for a hard limit on the resident
+ * size of the process instead, for small hosts where running slower is
+ * better than pushing out whatever else runs there.
+ *
+ * Everything else is small and does not grow with the input, short of the
+ * buckets (one per month) and the list of anomalies. Not counted either is
+ * the --cache state of a log, which is kept in memory while the log is
+ * processed: an accumulator for each of its blocks, some hundred bytes
+ * for each MiB of log.
+ */
+struct MemoryBudget
+{
+	/* input is read this much at a time, best a few batches */
+	size_t window = 4 << 20;
+	/* simdjson batch size, its buffers take several times that */
+	size_t batch_size = 1 << 20;
+	/* rows per Arrow record batch */
+	size_t arrow_rows = 65536;
+	/* SQLite page cache in bytes, 0 for its default */
+	size_t sqlite_cache = 0;
+
+	/*
+	 * Fits the buffers into `limit` bytes, less what is resident already;
+	 * throws if that leaves too little to work with.
+	 */
+	static MemoryBudget fit(size_t limit);
+
+	/*
+	 * Shares the window among `n` inputs that are each buffered at once
+	 * (followed logs), which share the parser; throws if that leaves too
+	 * little for a window.
+	 */
+	MemoryBudget split(size_t n) const;
+};
+
+/* a byte count with an optional K, M or G suffix (powers of 1024) */
+size_t parse_size(std::string_view s);
+
+size_t current_rss();
+size_t peak_rss();
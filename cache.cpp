@@ -0,0 +1,155 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "cache.hpp"
+#include "hash.hpp"
+#include "state.hpp"
+
+namespace fs = std::filesystem;
+
+static const char MAGIC[8] = {'L', 'C', 'E', 'C', 'A', 'C', 'H', 'E'};
+/* bump whenever the format or the accounting changes */
+static const uint32_t VERSION = 2;
+
+InputCache::InputCache(const fs::path &dir, const fs::path &input)
+	: input_(fs::weakly_canonical(input).native())
+	, zone_(local_zone()->name())
+{
+	/* one file per log, named after its path */
+	path_ = dir / fmt::format("{:016x}.cache", xxh64(input_));
+
+	std::ifstream f(path_, std::ios::binary);
+	if (!f) {
+		return;
+	}
+	std::string data{std::istreambuf_iterator<char>(f), {}};
+	if (!load(data)) {
+		blocks_.clear();
+		anomalies_.clear();
+	}
+}
+
+bool InputCache::load(const std::string &data)
+{
+	/* anything off just means starting over */
+	if (data.size() < sizeof(uint64_t)) {
+		return false;
+	}
+	std::string_view body(data.data(), data.size() - sizeof(uint64_t));
+	uint64_t checksum;
+	std::memcpy(&checksum, data.data() + body.size(), sizeof(checksum));
+	if (xxh64(body) != checksum) {
+		return false;
+	}
+
+	try {
+		StateReader r{body};
+		if (r.take(sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC))
+		    || r.get<uint32_t>() != VERSION
+		    || r.get<uint64_t>() != BLOCK_SIZE
+		    || r.get_string() != input_
+		    || r.get_string() != zone_) {
+			return false;
+		}
+
+		for (auto n = r.get<uint64_t>(); n; --n) {
+			uint64_t end = r.get<uint64_t>();
+			uint64_t hash = r.get<uint64_t>();
+			uint64_t anomalies = r.get<uint64_t>();
+			blocks_.push_back({end, hash, get_state(r), anomalies});
+		}
+		anomalies_ = get_anomalies(r);
+		return r.in.empty() && (blocks_.empty() || blocks_.back().anomalies == anomalies_.size());
+	} catch (const std::runtime_error &) {
+		return false;
+	}
+}
+
+void InputCache::save() const
+{
+	StateWriter w;
+	w.out.append(MAGIC, sizeof(MAGIC));
+	w.put<uint32_t>(VERSION);
+	w.put<uint64_t>(BLOCK_SIZE);
+	w.put_string(input_);
+	w.put_string(zone_);
+
+	w.put<uint64_t>(blocks_.size());
+	for (const auto &b: blocks_) {
+		w.put<uint64_t>(b.end);
+		w.put<uint64_t>(b.hash);
+		w.put<uint64_t>(b.anomalies);
+		put_state(w, b.acc);
+	}
+	put_anomalies(w, anomalies_);
+	w.put<uint64_t>(xxh64(w.out));
+
+	/* replace the old state atomically, a torn write would only be caught by the checksum */
+	fs::create_directories(path_.parent_path());
+	fs::path tmp = path_.native() + ".tmp";
+	{
+		std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+		f.write(w.out.data(), w.out.size());
+		if (!f.flush()) {
+			throw std::runtime_error(fmt::format("Failed to write {}", tmp));
+		}
+	}
+	fs::rename(tmp, path_);
+}
+
+bool InputCache::matches(std::string_view block)
+{
+	if (matched_ == blocks_.size()) {
+		return false;
+	}
+	size_t begin = matched_ ? blocks_[matched_ - 1].end : 0;
+	if (blocks_[matched_].end != begin + block.size() || blocks_[matched_].hash != xxh64(block)) {
+		/* only a prefix can be reused */
+		blocks_.resize(matched_);
+		return false;
+	}
+	++matched_;
+	return true;
+}
+
+size_t InputCache::restore(Accumulator &acc)
+{
+	blocks_.resize(matched_);
+	anomalies_.resize(matched_ ? blocks_.back().anomalies : 0);
+	if (!matched_) {
+		return 0;
+	}
+	const Accumulator &state = blocks_.back().acc;
+	acc.r = state.r;
+	acc.r.anomalies = anomalies_;
+	acc.prev = state.prev;
+	acc.is_first = state.is_first;
+	return blocks_.back().end;
+}
+
+void InputCache::seal(std::string_view block, const Accumulator &acc)
+{
+	Block b{
+		.end = (blocks_.empty() ? 0 : blocks_.back().end) + block.size(),
+		.hash = xxh64(block),
+		.acc = {},
+		.anomalies = acc.r.anomalies.size(),
+	};
+	/* everything but the anomalies, which are kept once for all blocks */
+	b.acc.r.total = acc.r.total;
+	b.acc.r.buckets = acc.r.buckets;
+	b.acc.r.rollovers = acc.r.rollovers;
+	b.acc.r.power_losses = acc.r.power_losses;
+	b.acc.r.bad = acc.r.bad;
+	b.acc.r.load = acc.r.load;
+	b.acc.prev = acc.prev;
+	b.acc.is_first = acc.is_first;
+	blocks_.push_back(std::move(b));
+
+	anomalies_.insert(anomalies_.end(), acc.r.anomalies.begin() + anomalies_.size(), acc.r.anomalies.end());
+}
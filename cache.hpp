@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "energy.hpp"
+
+/*
+ * Processing state of a log, kept between runs so that only what has
+ * changed since the last run is processed again.
+ *
+ * The log is cut into sealed blocks: about BLOCK_SIZE bytes each, ending
+ * at a newline. For each block, its hash and the accumulator state at
+ * its end are kept. A later run hashes the blocks of the log as it is
+ * now and resumes from the end of the longest unchanged prefix -- an
+ * appended log from its old end, an edited or restored one from the
+ * first block that differs. (Blocks after that are processed again too:
+ * the accounting is sequential, so their state depends on everything
+ * before them.)
+ *
+ * Size and mtime are not looked at, so edits that keep both and logs
+ * restored from backups are caught all the same.
+ */
+class InputCache
+{
+public:
+	static const size_t BLOCK_SIZE = 1 << 20;
+
+	/* keeps the state of `input` in a file under `dir` */
+	InputCache(const std::filesystem::path &dir, const std::filesystem::path &input);
+
+	/*
+	 * Checks the next block of the log (an InputWindows window of
+	 * BLOCK_SIZE) against the one kept from the last save(): false once
+	 * it differs, from then on the log is processed again.
+	 */
+	bool matches(std::string_view block);
+
+	/*
+	 * Restores `acc` to the end of the blocks that have matched, and
+	 * returns the length of them.
+	 */
+	size_t restore(Accumulator &acc);
+
+	/* records the block that `acc` has just been fed, from the end of the last one */
+	void seal(std::string_view block, const Accumulator &acc);
+
+	void save() const;
+
+	const std::filesystem::path &path() const { return path_; }
+
+private:
+	struct Block
+	{
+		uint64_t end;
+		uint64_t hash;
+		/* state at the end of the block, less the anomalies */
+		Accumulator acc;
+		uint64_t anomalies;
+	};
+
+	bool load(const std::string &data);
+
+	std::filesystem::path path_;
+	std::string input_;
+	std::string zone_;
+	std::vector<Block> blocks_;
+	size_t matched_ = 0;
+	/* all anomalies up to the last block, each block has a prefix of them */
+	std::vector<Anomaly> anomalies_;
+};
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <ctime>
+#include <ios>
+
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+
+#include "check.hpp"
+#include "input.hpp"
+
+LogCheck check_log(const std::filesystem::path &path, fp_seconds gap, const MemoryBudget &budget)
+{
+	LogCheck c;
+	auto max_step = std::chrono::duration_cast<ts_time::duration>(gap);
+	uint64_t good = 0;
+	/* of the document at hand, only counted once all of it has parsed */
+	std::vector<std::string_view> descriptions;
+
+	/* the window at hand, which starts at c.bytes into the log */
+	std::string_view window;
+	auto broken = [&](std::string_view raw) {
+		uint64_t begin = c.bytes + (raw.data() - window.data());
+		uint64_t end = begin + raw.size();
+		++c.broken;
+		/* broken lines in a row make up a single range */
+		if (!c.corrupt.empty() && begin <= c.corrupt.back().end + 1) {
+			c.corrupt.back().end = std::max(c.corrupt.back().end, end);
+			++c.corrupt.back().docs;
+		} else {
+			c.corrupt.push_back({begin, end, 1});
+		}
+	};
+
+	auto feed = [&](sj::document_reference doc) {
+		sj::value stamp = doc.find_field("timestamp");
+		std::string_view raw_stamp = stamp.raw_json_token();
+		ts_time ts;
+		try {
+			ts = parse_timestamp_fast(stamp.get_string());
+		} catch (const std::ios_base::failure &) {
+			/* JSON all right, but not a timestamp: the whole line is broken */
+			size_t at = raw_stamp.data() - window.data();
+			size_t begin = window.rfind('\n', at) + 1;
+			size_t end = std::min(window.find('\n', at), window.size());
+			broken(window.substr(begin, end - begin));
+			return;
+		}
+		descriptions.clear();
+		for (sj::object device: doc.find_field("data").get_array()) {
+			descriptions.push_back(device.find_field("description").get_string());
+		}
+
+		for (auto description: descriptions) {
+			auto it = c.devices.find(description);
+			if (it == c.devices.end()) {
+				it = c.devices.emplace(description, 0).first;
+			}
+			++it->second;
+		}
+		if (!good++) {
+			c.first = ts;
+		} else if (ts < c.last) {
+			++c.backwards;
+		} else if (ts - c.last > max_step) {
+			c.gaps.push_back({c.last, ts});
+		}
+		c.last = ts;
+		c.min = std::min(c.min, ts);
+		c.max = std::max(c.max, ts);
+	};
+
+	sj::parser parser;
+	InputWindows input(path, budget.window);
+	for (auto w = input.next(); !w.data.empty(); w = input.next()) {
+		window = w.data;
+		DocumentCursor cursor(parser, w.data, true, budget.batch_size);
+		cursor.on_broken([&](const char *, std::string_view raw) { broken(raw); });
+		while (cursor.next(feed)) {
+		}
+		c.docs += cursor.docs();
+		c.bytes += w.data.size();
+	}
+	return c;
+}
+
+static std::string json_string(std::string_view s)
+{
+	std::string out = "\"";
+	for (char ch: s) {
+		switch (ch) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(ch) < 0x20) {
+				out += fmt::format("\\u{:04x}", ch);
+			} else {
+				out += ch;
+			}
+		}
+	}
+	return out + "\"";
+}
+
+static std::string json_time(ts_time ts)
+{
+	auto s = std::chrono::floor<std::chrono::seconds>(ts);
+	/* broken down, as fmt before 10 formats a sys_time in the C library's zone */
+	std::time_t t = std::chrono::system_clock::to_time_t(s);
+	std::tm tm;
+	gmtime_r(&t, &tm);
+	return fmt::format("\"{:%FT%T}.{:09}Z\"", tm, (ts - s).count());
+}
+
+std::string check_json(const std::filesystem::path &path, const LogCheck &c)
+{
+	std::string out = fmt::format(
+		"{{\"log\": {}, \"ok\": {}, \"bytes\": {}, \"documents\": {}, \"broken\": {}, \"backwards\": {}",
+		json_string(path.native()), c.ok(), c.bytes, c.docs, c.broken, c.backwards
+	);
+
+	if (c.docs > c.broken) {
+		out += fmt::format(
+			", \"first\": {}, \"last\": {}, \"min\": {}, \"max\": {}, \"span_s\": {}",
+			json_time(c.first), json_time(c.last), json_time(c.min), json_time(c.max),
+			fp_seconds(c.max - c.min).count()
+		);
+	}
+
+	out += ", \"gaps\": [";
+	for (size_t i = 0; i < c.gaps.size(); ++i) {
+		out += fmt::format(
+			"{}{{\"from\": {}, \"to\": {}, \"length_s\": {}}}",
+			i ? ", " : "", json_time(c.gaps[i].from), json_time(c.gaps[i].to),
+			fp_seconds(c.gaps[i].to - c.gaps[i].from).count()
+		);
+	}
+	out += "], \"corrupt\": [";
+	for (size_t i = 0; i < c.corrupt.size(); ++i) {
+		out += fmt::format(
+			"{}{{\"begin\": {}, \"end\": {}, \"documents\": {}}}",
+			i ? ", " : "", c.corrupt[i].begin, c.corrupt[i].end, c.corrupt[i].docs
+		);
+	}
+	out += "], \"devices\": {";
+	bool first = true;
+	for (const auto &[description, docs]: c.devices) {
+		out += fmt::format("{}{}: {}", first ? "" : ", ", json_string(description), docs);
+		first = false;
+	}
+	return out + "}}";
+}
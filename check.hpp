@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "budget.hpp"
+#include "energy.hpp"
+
+/*
+ * What a log holds, as far as can be told without accounting it: for
+ * validating logs before they are archived.
+ *
+ * Documents go through the same structural scan, but only their
+ * timestamps and device descriptions are looked at -- no measurements,
+ * buckets or time zones.
+ */
+struct LogCheck
+{
+	/* a byte range of broken documents, end exclusive */
+	struct Corrupt
+	{
+		uint64_t begin, end;
+		uint64_t docs;
+	};
+
+	struct Gap
+	{
+		ts_time from, to;
+	};
+
+	uint64_t bytes = 0, docs = 0, broken = 0;
+	/* timestamps earlier than the one before them */
+	uint64_t backwards = 0;
+	/* of the first and the last good document, and the earliest and the latest */
+	ts_time first{}, last{}, min = ts_time::max(), max = ts_time::min();
+	std::vector<Gap> gaps;
+	std::vector<Corrupt> corrupt;
+	/* documents each device description is in */
+	std::map<std::string, uint64_t, std::less<>> devices;
+
+	bool ok() const { return !broken && !backwards; }
+};
+
+/* a gap is a step between timestamps longer than `gap` */
+LogCheck check_log(const std::filesystem::path &path, fp_seconds gap, const MemoryBudget &budget = {});
+
+/* a single line of JSON */
+std::string check_json(const std::filesystem::path &path, const LogCheck &c);
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "compact.hpp"
+#include "state.hpp"
+
+static const char MAGIC[8] = {'L', 'C', 'E', 'C', 'M', 'P', 'C', 'T'};
+/* bump whenever the format changes */
+static const uint32_t VERSION = 1;
+
+static void put_varint(std::string &out, uint64_t v)
+{
+	for (; v >= 0x80; v >>= 7) {
+		out += char(v | 0x80);
+	}
+	out += char(v);
+}
+
+static uint64_t get_varint(const char *&p, const char *end)
+{
+	uint64_t v = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7) {
+		uint8_t b = *p++;
+		v |= uint64_t(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			return v;
+		}
+	}
+	throw std::runtime_error("truncated block");
+}
+
+/* small steps either way make small varints */
+static uint64_t zigzag(int64_t v)
+{
+	return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+/* close values share their sign, exponent and top of the mantissa, so their XOR is small */
+static void put_double(std::string &out, double v, double prev)
+{
+	put_varint(out, std::bit_cast<uint64_t>(v) ^ std::bit_cast<uint64_t>(prev));
+}
+
+static double get_double(const char *&p, const char *end, double prev)
+{
+	return std::bit_cast<double>(get_varint(p, end) ^ std::bit_cast<uint64_t>(prev));
+}
+
+CompactWriter::CompactWriter(std::filesystem::path path, std::vector<std::string> sources, size_t block_rows)
+	: path_(std::move(path))
+	, tmp_path_(path_.native() + ".tmp")
+	, sources_(std::move(sources))
+	, block_rows_(block_rows)
+{
+	fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd_ < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to create {}", tmp_path_));
+	}
+
+	StateWriter w;
+	w.out.append(MAGIC, sizeof(MAGIC));
+	w.put<uint32_t>(VERSION);
+	try {
+		write(w.out);
+	} catch (...) {
+		close(fd_);
+		unlink(tmp_path_.c_str());
+		throw;
+	}
+}
+
+CompactWriter::~CompactWriter()
+{
+	if (fd_ >= 0) {
+		close(fd_);
+		unlink(tmp_path_.c_str());
+	}
+}
+
+void CompactWriter::write(std::string_view data)
+{
+	for (const char *p = data.data(), *end = p + data.size(); p < end; ) {
+		ssize_t r = ::write(fd_, p, end - p);
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", tmp_path_));
+		}
+		p += r;
+		offset_ += r;
+	}
+}
+
+void CompactWriter::append(uint32_t source, const Measurement &m)
+{
+	if (zone_.rows && (zone_.source != source || zone_.rows == block_rows_)) {
+		flush();
+	}
+	if (!zone_.rows) {
+		zone_ = {
+			.offset = offset_, .size = 0, .source = source, .rows = 0,
+			.min_ts = m.stamp, .max_ts = m.stamp,
+			.min_pwr = m.pwr, .max_pwr = m.pwr, .sum_pwr = 0,
+		};
+		/* each block decodes on its own */
+		prev_ = {};
+	}
+
+	put_varint(block_, zigzag((m.stamp - prev_.stamp).count()));
+	put_double(block_, m.uptime_cur, prev_.uptime_cur);
+	put_double(block_, m.uptime_tot, prev_.uptime_tot);
+	put_double(block_, m.pwr, prev_.pwr);
+	prev_ = m;
+
+	++zone_.rows;
+	zone_.min_ts = std::min(zone_.min_ts, m.stamp);
+	zone_.max_ts = std::max(zone_.max_ts, m.stamp);
+	zone_.min_pwr = std::min(zone_.min_pwr, m.pwr);
+	zone_.max_pwr = std::max(zone_.max_pwr, m.pwr);
+	zone_.sum_pwr += m.pwr;
+}
+
+void CompactWriter::flush()
+{
+	if (!zone_.rows) {
+		return;
+	}
+	zone_.size = block_.size();
+	write(block_);
+	zones_.push_back(zone_);
+	block_.clear();
+	zone_.rows = 0;
+}
+
+void CompactWriter::finish()
+{
+	flush();
+
+	/* the footer, then where it starts */
+	StateWriter w;
+	w.put<uint64_t>(sources_.size());
+	for (const auto &s: sources_) {
+		w.put_string(s);
+	}
+	w.put<uint64_t>(zones_.size());
+	for (const auto &z: zones_) {
+		w.put<uint64_t>(z.offset);
+		w.put<uint64_t>(z.size);
+		w.put<uint32_t>(z.source);
+		w.put<uint32_t>(z.rows);
+		w.put<int64_t>(z.min_ts.time_since_epoch().count());
+		w.put<int64_t>(z.max_ts.time_since_epoch().count());
+		w.put<double>(z.min_pwr);
+		w.put<double>(z.max_pwr);
+		w.put<double>(z.sum_pwr);
+	}
+	w.put<uint64_t>(offset_);
+	w.out.append(MAGIC, sizeof(MAGIC));
+	write(w.out);
+
+	if (close(std::exchange(fd_, -1)) < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", tmp_path_));
+	}
+	std::filesystem::rename(tmp_path_, path_);
+}
+
+void PowerSummary::add(const Measurement &m)
+{
+	++samples;
+	first = std::min(first, m.stamp);
+	last = std::max(last, m.stamp);
+	min = std::min(min, m.pwr);
+	max = std::max(max, m.pwr);
+	sum += m.pwr;
+}
+
+void PowerSummary::add(const CompactZone &z)
+{
+	samples += z.rows;
+	first = std::min(first, z.min_ts);
+	last = std::max(last, z.max_ts);
+	min = std::min(min, z.min_pwr);
+	max = std::max(max, z.max_pwr);
+	sum += z.sum_pwr;
+}
+
+CompactReader::CompactReader(const std::filesystem::path &path)
+	: path_(path)
+{
+	int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", path_));
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), fmt::format("Failed to stat {}", path_));
+	}
+	size_ = st.st_size;
+	if (size_) {
+		void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(), fmt::format("Failed to map {}", path_));
+		}
+		map_ = static_cast<const char *>(map);
+	}
+	close(fd);
+
+	std::string_view data(map_, size_);
+	size_t head = sizeof(MAGIC) + sizeof(uint32_t), tail = sizeof(uint64_t) + sizeof(MAGIC);
+	auto invalid = [&](std::string_view why) {
+		return std::runtime_error(fmt::format("{} is not a compact measurement file ({})", path_, why));
+	};
+	if (data.size() < head + tail
+	    || data.substr(0, sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC))
+	    || data.substr(data.size() - sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC))) {
+		throw invalid("no magic");
+	}
+	uint32_t version;
+	std::memcpy(&version, data.data() + sizeof(MAGIC), sizeof(version));
+	if (version != VERSION) {
+		throw invalid(fmt::format("version {}", version));
+	}
+	uint64_t footer;
+	std::memcpy(&footer, data.data() + data.size() - tail, sizeof(footer));
+	if (footer < head || footer > data.size() - tail) {
+		throw invalid("bad footer offset");
+	}
+
+	try {
+		StateReader r{data.substr(footer, data.size() - tail - footer)};
+		for (auto n = r.get<uint64_t>(); n; --n) {
+			sources_.emplace_back(r.get_string());
+		}
+		for (auto n = r.get<uint64_t>(); n; --n) {
+			CompactZone z;
+			z.offset = r.get<uint64_t>();
+			z.size = r.get<uint64_t>();
+			z.source = r.get<uint32_t>();
+			z.rows = r.get<uint32_t>();
+			z.min_ts = ts_time{ts_time::duration{r.get<int64_t>()}};
+			z.max_ts = ts_time{ts_time::duration{r.get<int64_t>()}};
+			z.min_pwr = r.get<double>();
+			z.max_pwr = r.get<double>();
+			z.sum_pwr = r.get<double>();
+			if (z.offset < head || z.offset > footer || z.size > footer - z.offset || z.source >= sources_.size()) {
+				throw invalid("bad zone map");
+			}
+			zones_.push_back(z);
+		}
+	} catch (const std::runtime_error &e) {
+		throw invalid(e.what());
+	}
+}
+
+CompactReader::~CompactReader()
+{
+	if (map_) {
+		munmap(const_cast<char *>(map_), size_);
+	}
+}
+
+std::vector<Measurement> CompactReader::decode(const CompactZone &z) const
+{
+	std::vector<Measurement> rows;
+	rows.reserve(z.rows);
+	const char *p = map_ + z.offset, *end = p + z.size;
+	Measurement prev{};
+	for (uint32_t i = 0; i < z.rows; ++i) {
+		Measurement m;
+		m.stamp = prev.stamp + ts_time::duration{unzigzag(get_varint(p, end))};
+		m.uptime_cur = get_double(p, end, prev.uptime_cur);
+		m.uptime_tot = get_double(p, end, prev.uptime_tot);
+		m.pwr = get_double(p, end, prev.pwr);
+		rows.push_back(m);
+		prev = m;
+	}
+	return rows;
+}
+
+PowerSummary CompactReader::query(ts_time since, ts_time until, uint32_t source, Scan &scan) const
+{
+	PowerSummary s;
+	for (const auto &z: zones_) {
+		if ((source != SOURCES && z.source != source) || z.max_ts < since || z.min_ts >= until) {
+			++scan.skipped;
+		} else if (z.min_ts >= since && z.max_ts < until) {
+			++scan.summarized;
+			s.add(z);
+		} else {
+			++scan.decoded;
+			for (const auto &m: decode(z)) {
+				if (m.stamp >= since && m.stamp < until) {
+					s.add(m);
+				}
+			}
+		}
+	}
+	return s;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "energy.hpp"
+
+/*
+ * A compact binary form of parsed measurements, for queries over long
+ * histories that would take a while to parse again.
+ *
+ * Rows are written in blocks of up to `block_rows` rows of a single
+ * source, delta-encoded: timestamps as varint steps, doubles as varints
+ * of their XOR with the ones before. The footer keeps a zone map of each
+ * block -- its time span and its least, greatest and total power -- so
+ * that a query skips the blocks outside its range, takes the ones wholly
+ * inside it from their zone maps, and only decodes the ones on its edges.
+ *
+ * Native byte order, like the Arrow export. Written under a temporary
+ * name and only renamed into place by finish().
+ */
+struct CompactZone
+{
+	uint64_t offset, size;
+	uint32_t source, rows;
+	ts_time min_ts, max_ts;
+	double min_pwr, max_pwr, sum_pwr;
+};
+
+class CompactWriter
+{
+public:
+	CompactWriter(std::filesystem::path path, std::vector<std::string> sources, size_t block_rows = 4096);
+	~CompactWriter();
+
+	CompactWriter(const CompactWriter &) = delete;
+	CompactWriter &operator=(const CompactWriter &) = delete;
+
+	/* `source` indexes the sources given to the constructor */
+	void append(uint32_t source, const Measurement &m);
+	void finish();
+
+private:
+	void flush();
+	void write(std::string_view data);
+
+	std::filesystem::path path_, tmp_path_;
+	std::vector<std::string> sources_;
+	size_t block_rows_;
+	int fd_ = -1;
+	uint64_t offset_ = 0;
+
+	/* the block being filled */
+	std::string block_;
+	CompactZone zone_{};
+	Measurement prev_{};
+	std::vector<CompactZone> zones_;
+};
+
+/* power over a span of time, as a query returns it */
+struct PowerSummary
+{
+	uint64_t samples = 0;
+	ts_time first = ts_time::max(), last = ts_time::min();
+	double min = std::numeric_limits<double>::infinity();
+	double max = -std::numeric_limits<double>::infinity();
+	double sum = 0;
+
+	void add(const Measurement &m);
+	void add(const CompactZone &z);
+	double mean() const { return samples ? sum / samples : 0; }
+};
+
+/* maps the whole file; throws std::runtime_error if it is not a compact file */
+class CompactReader
+{
+public:
+	explicit CompactReader(const std::filesystem::path &path);
+	~CompactReader();
+
+	CompactReader(const CompactReader &) = delete;
+	CompactReader &operator=(const CompactReader &) = delete;
+
+	const std::vector<std::string> &sources() const { return sources_; }
+	const std::vector<CompactZone> &zones() const { return zones_; }
+
+	/* decodes the rows of a block */
+	std::vector<Measurement> decode(const CompactZone &z) const;
+
+	/* how a query got at the blocks */
+	struct Scan
+	{
+		size_t skipped = 0, summarized = 0, decoded = 0;
+	};
+
+	/* power in [since, until), of the source `source` or of all of them (SOURCES) */
+	static const constexpr uint32_t SOURCES = UINT32_MAX;
+	PowerSummary query(ts_time since, ts_time until, uint32_t source, Scan &scan) const;
+
+private:
+	std::filesystem::path path_;
+	const char *map_ = nullptr;
+	size_t size_ = 0;
+	std::vector<std::string> sources_;
+	std::vector<CompactZone> zones_;
+};
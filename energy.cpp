@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+
+#if LIQUIDCTL_ENERGY_MULTIVERSION
+#include <immintrin.h>
+#endif
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+#include <fmt/chrono.h>
+#include <date/date.h>
+
+#include "energy.hpp"
+#include "svstream.hpp"
+
+using namespace std::string_view_literals;
+
+double parse_item(sj::object obj, std::string_view unit)
+{
+	auto value = obj.find_field("value").get_double().value();
+	if (obj.find_field("unit").get_string() != unit) {
+		throw std::runtime_error(
+			fmt::format(
+				"Bad item: {}, expected unit: \"{}\"",
+				obj.raw_json().value(),
+				unit
+			));
+	}
+	return value;
+}
+
+ts_time parse_timestamp(std::string_view s)
+{
+	isvstream ss{s};
+	ss.exceptions(std::ios::failbit);
+
+	ts_time ret;
+	// 2023-05-31T00:13:57,906371842+03:00
+	ss >> date::parse("%FT%T%Ez", ret);
+
+	return ret;
+}
+
+/* parses exactly `n` decimal digits */
+static bool parse_digits(const char *&p, int n, int &out)
+{
+	out = 0;
+	for (int i = 0; i < n; ++i, ++p) {
+		unsigned d = *p - '0';
+		if (d > 9) {
+			return false;
+		}
+		out = out * 10 + d;
+	}
+	return true;
+}
+
+/* of "2023-05-31T00:13:57,906371842+03:00", unchecked beyond the layout */
+struct TimestampFields
+{
+	int Y, M, D, h, m, sec;
+	long ns;
+	int off_h, off_m;
+	bool negative;
+};
+
+static bool parse_fields_scalar(std::string_view s, TimestampFields &f)
+{
+	const char *p = s.data(), *end = s.data() + s.size();
+	if (!(parse_digits(p, 4, f.Y) && *p++ == '-' &&
+	      parse_digits(p, 2, f.M) && *p++ == '-' &&
+	      parse_digits(p, 2, f.D) && *p++ == 'T' &&
+	      parse_digits(p, 2, f.h) && *p++ == ':' &&
+	      parse_digits(p, 2, f.m) && *p++ == ':' &&
+	      parse_digits(p, 2, f.sec))) {
+		return false;
+	}
+
+	f.ns = 0;
+	if (p < end && (*p == ',' || *p == '.')) {
+		int digits = 0;
+		for (++p; p < end && unsigned(*p - '0') <= 9; ++p, ++digits) {
+			if (digits < 9) {
+				f.ns = f.ns * 10 + (*p - '0');
+			}
+		}
+		/* past nanoseconds, parse_timestamp() has the say on rounding or rejecting them */
+		if (digits == 0 || digits > 9) {
+			return false;
+		}
+		for (; digits < 9; ++digits) {
+			f.ns *= 10;
+		}
+	}
+
+	if (end - p != 6 || (*p != '+' && *p != '-')) {
+		return false;
+	}
+	f.negative = *p++ == '-';
+	return parse_digits(p, 2, f.off_h) && *p++ == ':' && parse_digits(p, 2, f.off_m);
+}
+
+#if LIQUIDCTL_ENERGY_MULTIVERSION
+/*
+ * Function multiversioning: the variant for the CPU at hand is picked
+ * once, when the binary is loaded. The SIMD variant only takes the exact
+ * layout liquidctl writes (nanoseconds, an offset); AVX2 and AVX-512 have
+ * nothing to add to a 35-byte string.
+ */
+__attribute__((target("default")))
+static bool parse_fields(std::string_view s, TimestampFields &f)
+{
+	return parse_fields_scalar(s, f);
+}
+
+__attribute__((target("sse4.2")))
+static bool parse_fields(std::string_view s, TimestampFields &f)
+{
+	// 2023-05-31T00:13:57,906371842+03:00
+	if (s.size() != "2023-05-31T00:13:57,906371842+03:00"sv.size()) {
+		return parse_fields_scalar(s, f);
+	}
+
+	/* "2023-05-31T00:13", "3-05-31T00:13:57" and ",906371842+03:00" */
+	__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data()));
+	__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data() + 3));
+	__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data() + 19));
+	__m128i zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9);
+	__m128i da = _mm_sub_epi8(a, zero), db = _mm_sub_epi8(b, zero), dc = _mm_sub_epi8(c, zero);
+
+	/*
+	 * Of the bytes in `care`, the `sep` ones have to match `seps` exactly
+	 * and the others have to be digits: bytes that have not wrapped around
+	 * past 9 once '0' is taken off.
+	 */
+	auto layout = [&](__m128i v, __m128i d, __m128i seps, int care, int sep) {
+		int digits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d, nine), d));
+		int matched = _mm_movemask_epi8(_mm_cmpeq_epi8(v, seps));
+		return (digits & care & ~sep) == (care & ~sep) && (matched & sep) == sep;
+	};
+	const __m128i seps_a = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 0, 0, 'T', 0, 0, ':', 0, 0);
+	const __m128i seps_b = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', 0, 0);
+	const __m128i seps_c = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', 0, 0);
+	if (!layout(a, da, seps_a, 0xffff, 0x2490) || !layout(b, db, seps_b, 0xe000, 0x2000)
+	    || !layout(c, dc, seps_c, 0xfbfe, 0x2000)
+	    || (s[19] != ',' && s[19] != '.') || (s[29] != '+' && s[29] != '-')) {
+		return parse_fields_scalar(s, f);
+	}
+
+	/* pairs of digits into 10 * a + b */
+	const __m128i tens = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+	__m128i date = _mm_or_si128(
+		_mm_shuffle_epi8(da, _mm_setr_epi8(0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1)),
+		_mm_shuffle_epi8(db, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1))
+	);
+	__m128i rest = _mm_shuffle_epi8(dc, _mm_setr_epi8(1, 2, 3, 4, 5, 6, 7, 8, -1, 9, 11, 12, 14, 15, -1, -1));
+	alignas(16) uint16_t d[8], r[8];
+	_mm_store_si128(reinterpret_cast<__m128i *>(d), _mm_maddubs_epi16(date, tens));
+	_mm_store_si128(reinterpret_cast<__m128i *>(r), _mm_maddubs_epi16(rest, tens));
+
+	f.Y = d[0] * 100 + d[1];
+	f.M = d[2];
+	f.D = d[3];
+	f.h = d[4];
+	f.m = d[5];
+	f.sec = d[6];
+	f.ns = ((r[0] * 100L + r[1]) * 10000 + r[2] * 100 + r[3]) * 10 + r[4];
+	f.negative = s[29] == '-';
+	f.off_h = r[5];
+	f.off_m = r[6];
+	return true;
+}
+
+/* callers elsewhere would not see the variants, and always get the default */
+__attribute__((target("default")))
+static const char *parse_fields_variant()
+{
+	return "scalar";
+}
+
+__attribute__((target("sse4.2")))
+static const char *parse_fields_variant()
+{
+	return "SSE4.2";
+}
+
+const char *timestamp_kernel()
+{
+	return parse_fields_variant();
+}
+#else
+static bool parse_fields(std::string_view s, TimestampFields &f)
+{
+	return parse_fields_scalar(s, f);
+}
+
+const char *timestamp_kernel()
+{
+	return "scalar";
+}
+#endif
+
+ts_time parse_timestamp_fast(std::string_view s)
+{
+	using namespace std::chrono;
+
+	// 2023-05-31T00:13:57,906371842+03:00
+	TimestampFields f;
+	if (s.size() < "2023-05-31T00:13:57+03:00"sv.size() || !parse_fields(s, f)) {
+		return parse_timestamp(s);
+	}
+
+	/* leap seconds and odd offsets are left to parse_timestamp() as well, to get the same result */
+	year_month_day ymd{year{f.Y}, month(f.M), day(f.D)};
+	if (!ymd.ok() || f.h > 23 || f.m > 59 || f.sec > 59 || f.off_h > 23 || f.off_m > 59) {
+		return parse_timestamp(s);
+	}
+
+	auto offset = hours{f.off_h} + minutes{f.off_m};
+	return ts_time{sys_days{ymd}} + hours{f.h} + minutes{f.m} + seconds{f.sec} + nanoseconds{f.ns}
+		- (f.negative ? -offset : offset);
+}
+
+Measurement parse_measurement(sj::document_reference doc, ts_time (*parse_ts)(std::string_view))
+{
+	auto ts = parse_ts(doc.find_field("timestamp").get_string());
+
+	sj::array device_items;
+	for (sj::object device: doc.find_field("data").get_array()) {
+		if (device.find_field("description").get_string() == "Corsair HX1000i"sv) {
+			device_items = device.find_field("status").get_array();
+			break;
+		}
+	}
+
+	double uptime_cur, uptime_tot, pwr_input;
+	for (sj::object item: device_items) {
+		std::string_view key = item.find_field("key").get_string();
+		if (key == "Current uptime") {
+			uptime_cur = parse_item(item, "s");
+		} else if (key == "Total uptime") {
+			uptime_tot = parse_item(item, "s");
+		} else if (key == "Estimated input power") {
+			pwr_input = parse_item(item, "W");
+		}
+	}
+
+	return {
+		.stamp = ts,
+		.uptime_cur = uptime_cur,
+		.uptime_tot = uptime_tot,
+		.pwr = pwr_input,
+	};
+}
+
+void report_parse_error(const char *what, std::string_view raw)
+{
+	fmt::print(stderr, "Failed to parse ({}):\n{}\n", what, raw);
+}
+
+std::vector<std::string> compare_results(const Result &a, const Result &b)
+{
+	std::vector<std::string> diffs;
+
+	auto compare_group = [&](std::string_view what, const GroupResult &ga, const GroupResult &gb) {
+		if (ga.time != gb.time || ga.energy_j != gb.energy_j) {
+			diffs.push_back(fmt::format(
+				"{}: {} s, {} J vs. {} s, {} J",
+				what,
+				ga.time.count(), ga.energy_j,
+				gb.time.count(), gb.energy_j
+			));
+		}
+		for (int s = 0; s < LOAD_STATES; ++s) {
+			if (ga.load_time[s] != gb.load_time[s] || ga.load_energy_j[s] != gb.load_energy_j[s]) {
+				diffs.push_back(fmt::format(
+					"{}, {}: {} s, {} J vs. {} s, {} J",
+					what, load_state_name(LoadState(s)),
+					ga.load_time[s].count(), ga.load_energy_j[s],
+					gb.load_time[s].count(), gb.load_energy_j[s]
+				));
+			}
+		}
+	};
+
+	compare_group("total", a.total, b.total);
+
+	for (auto ia = a.buckets.begin(), ib = b.buckets.begin(); ia != a.buckets.end() || ib != b.buckets.end(); ) {
+		if (ib == b.buckets.end() || (ia != a.buckets.end() && ia->first < ib->first)) {
+			diffs.push_back(fmt::format("bucket {:04d}-{:02d} only in the first result", std::get<0>(ia->first), std::get<1>(ia->first)));
+			++ia;
+		} else if (ia == a.buckets.end() || ib->first < ia->first) {
+			diffs.push_back(fmt::format("bucket {:04d}-{:02d} only in the second result", std::get<0>(ib->first), std::get<1>(ib->first)));
+			++ib;
+		} else {
+			compare_group(fmt::format("bucket {:04d}-{:02d}", std::get<0>(ia->first), std::get<1>(ia->first)), ia->second, ib->second);
+			++ia, ++ib;
+		}
+	}
+
+	if (a.rollovers != b.rollovers || a.power_losses != b.power_losses || a.bad != b.bad) {
+		diffs.push_back(fmt::format(
+			"rollovers/power losses/bad: {}/{}/{} vs. {}/{}/{}",
+			a.rollovers, a.power_losses, a.bad,
+			b.rollovers, b.power_losses, b.bad
+		));
+	}
+
+	size_t n = std::min(a.anomalies.size(), b.anomalies.size());
+	auto mismatch = std::mismatch(a.anomalies.begin(), a.anomalies.begin() + n, b.anomalies.begin());
+	if (mismatch.first != a.anomalies.begin() + n) {
+		diffs.push_back(fmt::format(
+			"anomaly #{}: kind {} at {} vs. kind {} at {}",
+			mismatch.first - a.anomalies.begin(),
+			(int)mismatch.first->kind, mismatch.first->stamp,
+			(int)mismatch.second->kind, mismatch.second->stamp
+		));
+	} else if (a.anomalies.size() != b.anomalies.size()) {
+		diffs.push_back(fmt::format("{} vs. {} anomalies", a.anomalies.size(), b.anomalies.size()));
+	}
+
+	return diffs;
+}
+
+void DocumentCursor::start_batch()
+{
+#ifdef SIMDJSON_THREADS_ENABLED
+	/*
+	 * simdjson's stage 1 thread is started, and its parser allocated,
+	 * anew for each stream; it is no faster at the size of an input window
+	 */
+	parser_.threaded = false;
+#endif
+	if (auto err = parser_.iterate_many(input_.data() + offset_, input_.size() - offset_, batch_size_).get(stream_)) {
+		throw simdjson::simdjson_error(err);
+	}
+	it_ = stream_.begin();
+	in_batch_ = true;
+	next_ = input_.size();
+	done_ = offset_;
+}
+
+void DocumentCursor::end_batch(bool salvage)
+{
+	in_batch_ = false;
+	if (!salvage && next_ == input_.size() && stream_.truncated_bytes()) {
+		/* an unterminated document at the end is dropped silently, make it fail loudly */
+		next_ = std::max(input_.size() - stream_.truncated_bytes(), done_);
+		salvage = true;
+	}
+	offset_ = next_;
+	/* salvage a batch worth of lines, then try batches again */
+	salvage_end_ = salvage ? std::min(input_.size(), next_ + batch_size_) : 0;
+}
+
+void DocumentCursor::report(const char *what, std::string_view raw) const
+{
+	if (broken_) {
+		broken_(what, raw);
+	} else if (!quiet_) {
+		report_parse_error(what, raw);
+	}
+}
+
+const std::chrono::time_zone *local_zone()
+{
+	/* <chrono> itself only goes by /etc/localtime */
+	static auto zone = [] {
+		std::string_view tz = std::getenv("TZ") ? std::getenv("TZ") : "";
+		/* the C library's way of naming a zone rather than giving its rules */
+		if (tz.starts_with(':')) {
+			tz.remove_prefix(1);
+		}
+		if (!tz.empty()) {
+			try {
+				return std::chrono::locate_zone(tz);
+			} catch (const std::runtime_error &) {
+				/* e.g. rules like "CET-1CEST", which the C library takes and tzdb does not */
+			}
+		}
+		return std::chrono::current_zone();
+	}();
+	return zone;
+}
+
+GroupKey GroupKey::from_time(ts_time ts)
+{
+	ts_time begin, end;
+	return from_time(ts, begin, end);
+}
+
+GroupKey GroupKey::from_time(ts_time ts, ts_time &begin, ts_time &end)
+{
+	using namespace std::chrono;
+
+	auto zone = local_zone();
+
+	/* within [info.begin, info.end), local time is `ts` shifted by a constant offset */
+	auto info = zone->get_info(ts);
+	auto ts_local = local_time<nanoseconds>{ts.time_since_epoch() + info.offset};
+	auto ymd = year_month_day{ floor<days>(ts_local) };
+
+	auto month_begin = local_days{ymd.year() / ymd.month() / 1};
+	auto month_end = local_days{(ymd.year() / ymd.month() + months{1}) / 1};
+	/* sys_info bounds may be far beyond the range of ts_time, compare them at their own precision */
+	begin = std::max(info.begin, sys_seconds{month_begin.time_since_epoch()} - info.offset);
+	end = std::min(info.end, sys_seconds{month_end.time_since_epoch()} - info.offset);
+
+	return {(int)ymd.year(), (unsigned)ymd.month()};
+}
+
+const char *load_state_name(LoadState s)
+{
+	static const char *const names[LOAD_STATES] = {"idle", "normal", "peak"};
+	return names[s];
+}
+
+LoadState LoadClassifier::classify(double pwr)
+{
+	if (!seen) {
+		std::fill(std::begin(centroid), std::end(centroid), pwr);
+		seen = true;
+	}
+
+	/* of equally near centroids, the middle one, else the outer one: moving it then keeps them ordered */
+	double d_idle = std::abs(pwr - centroid[IDLE]), d_normal = std::abs(pwr - centroid[NORMAL]), d_peak = std::abs(pwr - centroid[PEAK]);
+	LoadState s = NORMAL;
+	double d = d_normal;
+	if (d_idle < d || (d_idle == d && pwr < centroid[IDLE])) {
+		s = IDLE;
+		d = d_idle;
+	}
+	if (d_peak < d || (d_peak == d && pwr > centroid[PEAK])) {
+		s = PEAK;
+	}
+
+	count[s] = std::min(count[s] + 1, ADAPT);
+	centroid[s] += (pwr - centroid[s]) / count[s];
+	return s;
+}
+
+void account_step(Result &r, ts_time ts, fp_seconds time, double energy)
+{
+	if (!r.last.bucket || ts < r.last.begin || ts >= r.last.end) {
+		r.last.bucket = &r.buckets[GroupKey::from_time(ts, r.last.begin, r.last.end)];
+	}
+	/* a step of no time has no power, and nothing to split */
+	LoadState s = time.count() ? r.load.classify(energy / time.count()) : NORMAL;
+
+	r.total.time += time;
+	r.total.energy_j += energy;
+	r.total.load_time[s] += time;
+	r.total.load_energy_j[s] += energy;
+	r.last.bucket->time += time;
+	r.last.bucket->energy_j += energy;
+	r.last.bucket->load_time[s] += time;
+	r.last.bucket->load_energy_j[s] += energy;
+}
+
+void process_step(Result &r, const Measurement &prev, const Measurement &last, bool quiet)
+{
+	fp_seconds delta_wall{last.stamp - prev.stamp};
+	fp_seconds delta_uptime_tot{last.uptime_tot - prev.uptime_tot};
+	fp_seconds delta_uptime_cur{last.uptime_cur - prev.uptime_cur};
+	fp_seconds uptime{last.uptime_cur};
+
+	bool delta_uptime_bad = (
+		delta_uptime_tot.count() < uptime.count()
+	);
+
+	if (std::abs(delta_wall.count() - delta_uptime_tot.count()) < 2) {
+		/* OK */
+	} else if (std::abs(delta_uptime_tot.count() - delta_uptime_cur.count()) < 1) {
+		/* imprecise wall time recorded, but no rollover has occurred -- OK for now */
+	} else if (delta_wall.count() > uptime.count()) {
+		if (!quiet) {
+			fmt::print(""
+				   "Rollover: at   {} uptime_cur={} uptime_tot={}\n"
+				   "          prev {} uptime_cur={} uptime_tot={}\n"
+				   "          wall clock delta: {}\n"
+				   "              uptime delta: t. {}{}\n"
+				   "                    uptime: {}\n"
+				,
+				   last.stamp, last.uptime_cur, last.uptime_tot,
+				   prev.stamp, prev.uptime_cur, prev.uptime_tot,
+				   delta_wall,
+				   delta_uptime_bad ? "(invalid) " : "", delta_uptime_tot,
+				   uptime
+			);
+		}
+
+		++r.rollovers;
+		if (delta_uptime_bad) {
+			++r.power_losses;
+			r.anomalies.push_back({ Anomaly::POWER_LOSS, last.stamp });
+			/* total uptime was not properly updated -- assuming a power loss has occurred, use only this measurement */
+			account_step(r, last.stamp, uptime, last.pwr * uptime.count());
+			return;
+		} else {
+			r.anomalies.push_back({ Anomaly::ROLLOVER, last.stamp });
+			/* total uptime was updated -- use that delta instead of the wall clock delta */
+			delta_wall = delta_uptime_tot;
+		}
+	} else {
+		if (!quiet) {
+			fmt::print(""
+				   "!!! INCONSISTENT MEASUREMENT !!!"
+				   "          at   {} uptime_cur={} uptime_tot={}\n"
+				   "          prev {} uptime_cur={} uptime_tot={}\n"
+				   "          wall clock delta: {}\n"
+				   "              uptime delta: t. {}{}, cur. {}\n"
+				   "                    uptime: {}\n"
+				,
+				   last.stamp, last.uptime_cur, last.uptime_tot,
+				   prev.stamp, prev.uptime_cur, prev.uptime_tot,
+				   delta_wall,
+				   delta_uptime_bad ? "(invalid) " : "", delta_uptime_tot, delta_uptime_cur,
+				   uptime
+			);
+		}
+
+		r.bad = true;
+		r.anomalies.push_back({ Anomaly::INCONSISTENT, last.stamp });
+		return;
+	}
+
+	account_step(r, prev.stamp, delta_wall, (prev.pwr + last.pwr) * delta_wall.count() / 2);
+}
+
+void merge(Result &into, const Result &from)
+{
+	auto add = [](GroupResult &a, const GroupResult &b) {
+		a.time += b.time;
+		a.energy_j += b.energy_j;
+		for (int s = 0; s < LOAD_STATES; ++s) {
+			a.load_time[s] += b.load_time[s];
+			a.load_energy_j[s] += b.load_energy_j[s];
+		}
+	};
+
+	add(into.total, from.total);
+	for (const auto &[key, bucket]: from.buckets) {
+		add(into.buckets[key], bucket);
+	}
+	into.rollovers += from.rollovers;
+	into.power_losses += from.power_losses;
+	into.bad |= from.bad;
+
+	size_t n = into.anomalies.size();
+	into.anomalies.insert(into.anomalies.end(), from.anomalies.begin(), from.anomalies.end());
+	std::inplace_merge(into.anomalies.begin(), into.anomalies.begin() + n, into.anomalies.end(),
+			   [](const Anomaly &a, const Anomaly &b) { return a.stamp < b.stamp; });
+}
+
+void Accumulator::feed(const Measurement &m)
+{
+	if (is_first) {
+		is_first = false;
+	} else {
+		if (reference) {
+			r.last = {};
+		}
+		process_step(r, prev, m, quiet);
+	}
+
+	prev = m;
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <simdjson.h>
+
+namespace sj = simdjson::ondemand;
+
+using ts_time = std::chrono::sys_time<std::chrono::nanoseconds>;
+using ts_zoned = std::chrono::zoned_time<std::chrono::nanoseconds>;
+using fp_seconds = std::chrono::duration<double>;
+
+struct Measurement
+{
+	ts_time stamp;
+	double uptime_cur, uptime_tot;
+	double pwr;
+};
+
+/*
+ * The time zone that buckets and other calendar periods are in: the one
+ * that $TZ names, as for the C library, else the system's.
+ */
+const std::chrono::time_zone *local_zone();
+
+struct GroupKey : public std::tuple<int, int>
+{
+public:
+	GroupKey(auto &&... ts)
+		: std::tuple<int, int>(std::forward<decltype(ts)>(ts)...)
+	{ }
+
+	static GroupKey from_time(ts_time ts);
+	/* also returns the span of time around `ts` that maps to the same key */
+	static GroupKey from_time(ts_time ts, ts_time &begin, ts_time &end);
+};
+
+/* by increasing power */
+enum LoadState { IDLE, NORMAL, PEAK, LOAD_STATES };
+
+const char *load_state_name(LoadState s);
+
+struct GroupResult
+{
+	static const constexpr double COST_KWH = 7.79;
+	fp_seconds time;
+	double energy_j;
+	/* the above split by load state */
+	fp_seconds load_time[LOAD_STATES];
+	double load_energy_j[LOAD_STATES];
+	double energy_kwh() const { return energy_j / 3600 / 1000; }
+};
+
+/*
+ * Tells load states apart by online k-means over the mean power of
+ * integration steps: a centroid per state, each step moves the nearest
+ * one towards its power. Past ADAPT steps of a state, its centroid
+ * becomes an exponential average, to follow the load drifting over the
+ * months. Starts from all centroids at the first power seen, so until
+ * the power changes everything is NORMAL.
+ */
+struct LoadClassifier
+{
+	static const constexpr uint64_t ADAPT = 4096;
+	double centroid[LOAD_STATES];
+	uint64_t count[LOAD_STATES];
+	bool seen;
+
+	LoadState classify(double pwr);
+};
+
+/*
+ * The bucket that account_step() has used last, along with the span of
+ * time that maps to it, to skip both the time zone and the map lookups.
+ * Points into the owning Result, so it is not carried over by copies.
+ */
+struct LastBucket
+{
+	ts_time begin{}, end{};
+	GroupResult *bucket{};
+
+	LastBucket() = default;
+	LastBucket(const LastBucket &) { }
+	LastBucket &operator=(const LastBucket &) { bucket = nullptr; return *this; }
+};
+
+struct Anomaly
+{
+	enum Kind { ROLLOVER, POWER_LOSS, INCONSISTENT } kind;
+	ts_time stamp;
+
+	bool operator==(const Anomaly &) const = default;
+};
+
+struct Result
+{
+	GroupResult total;
+	std::map<GroupKey, GroupResult> buckets;
+	unsigned rollovers;
+	unsigned power_losses;
+	bool bad;
+	std::vector<Anomaly> anomalies;
+	LastBucket last;
+	LoadClassifier load;
+};
+
+/*
+ * Adds up results of separate measurement sequences (e.g. of different
+ * hosts); the gap between two sequences of the same host is not
+ * integrated. Anomalies are kept in chronological order. The load
+ * classifier of `into` is kept, the load states have been told apart by
+ * each sequence's own.
+ */
+void merge(Result &into, const Result &from);
+
+/*
+ * Feeds a sequence of measurements into a Result, one integration step
+ * per consecutive pair.
+ */
+struct Accumulator
+{
+	Result r{};
+	Measurement prev{};
+	bool is_first = true;
+	/* skip the account_step() bucket cache, for cross-checking it */
+	bool reference = false;
+	/* do not print anomalies as they are found */
+	bool quiet = false;
+
+	void feed(const Measurement &m);
+};
+
+/*
+ * Lists the differences between two results, which are expected to be
+ * exactly equal (same operations in the same order).
+ */
+std::vector<std::string> compare_results(const Result &a, const Result &b);
+
+double parse_item(sj::object obj, std::string_view unit);
+ts_time parse_timestamp(std::string_view s);
+/*
+ * hand-rolled parse_timestamp() for the exact format liquidctl logs have,
+ * falls back to it for anything else (leap seconds included)
+ */
+ts_time parse_timestamp_fast(std::string_view s);
+/* the variant of parse_timestamp_fast() picked for this CPU */
+const char *timestamp_kernel();
+Measurement parse_measurement(sj::document_reference doc, ts_time (*parse_ts)(std::string_view) = parse_timestamp_fast);
+
+void report_parse_error(const char *what, std::string_view raw);
+
+/*
+ * The documents of newline-delimited `input`, which must be padded for
+ * simdjson, handed out one at a time by next().
+ *
+ * Broken documents are reported (unless `quiet`) and skipped. A broken
+ * line may also fail the structural scan of the whole batch it is in, or
+ * swallow the lines that follow it; the rest of such a batch is parsed
+ * line by line.
+ *
+ * The parser's buffers are sized for `batch_size`; a document longer
+ * than that fails the batch and is parsed on its own. Past that, the only
+ * heap allocation is simdjson's stage 1 worker, one for each stream of
+ * batches where simdjson is built with threads.
+ */
+class DocumentCursor
+{
+public:
+	/* what is wrong, and the broken document (a view into the input) */
+	using Broken = std::function<void(const char *what, std::string_view raw)>;
+
+	DocumentCursor(sj::parser &parser, std::string_view input, bool quiet = false, size_t batch_size = sj::DEFAULT_BATCH_SIZE)
+		: parser_(parser)
+		, input_(input)
+		, quiet_(quiet)
+		, batch_size_(batch_size)
+	{
+	}
+
+	/* the stream points back into the cursor */
+	DocumentCursor(const DocumentCursor &) = delete;
+	DocumentCursor &operator=(const DocumentCursor &) = delete;
+
+	/*
+	 * Calls `cb` for the next document that it does not throw a
+	 * simdjson_error for (those count as broken). False at the end of the
+	 * input.
+	 */
+	template<typename F>
+	bool next(F &&cb);
+
+	/* documents so far, broken ones included */
+	size_t docs() const { return docs_; }
+
+	/* hands broken documents to `cb` instead of reporting them */
+	void on_broken(Broken cb) { broken_ = std::move(cb); }
+
+private:
+	void start_batch();
+	void end_batch(bool salvage);
+	void report(const char *what, std::string_view raw) const;
+
+	sj::parser &parser_;
+	std::string_view input_;
+	bool quiet_;
+	size_t batch_size_;
+	Broken broken_;
+	size_t docs_ = 0, offset_ = 0;
+
+	/* the batch being iterated, if any: where to go on from after it, and the end of what has been parsed */
+	bool in_batch_ = false;
+	sj::document_stream stream_;
+	sj::document_stream::iterator it_;
+	size_t next_ = 0, done_ = 0;
+
+	/* lines up to here are parsed one by one */
+	size_t salvage_end_ = 0;
+};
+
+template<typename F>
+bool DocumentCursor::next(F &&cb)
+{
+	for (;;) {
+		while (offset_ < salvage_end_) {
+			size_t eol = std::min(input_.find('\n', offset_), input_.size());
+			std::string_view line = input_.substr(offset_, eol - offset_);
+			offset_ = eol + 1;
+
+			if (line.find_first_not_of(" \t\r") == line.npos) {
+				continue;
+			}
+			++docs_;
+
+			/* the rest of the input is readable padding as far as simdjson is concerned */
+			sj::document doc;
+			size_t capacity = input_.size() - (line.data() - input_.data()) + simdjson::SIMDJSON_PADDING;
+			auto err = parser_.iterate(line.data(), line.size(), capacity).get(doc);
+			if (!err) try {
+				cb(sj::document_reference(doc));
+				return true;
+			} catch (const simdjson::simdjson_error &e) {
+				err = e.error();
+			}
+			report(simdjson::error_message(err), line);
+		}
+
+		if (!in_batch_) {
+			if (offset_ >= input_.size()) {
+				return false;
+			}
+			start_batch();
+		}
+		/* the stream's iterator only has != */
+		if (!(it_ != stream_.end())) {
+			end_batch(false);
+			continue;
+		}
+
+		sj::document_reference doc;
+		if ((*it_).get(doc)) {
+			next_ = std::max(offset_ + it_.current_index(), done_);
+			end_batch(true);
+			continue;
+		}
+
+		/* not doc.raw_json(): that moves the stream on a broken document */
+		std::string_view raw = it_.source();
+		size_t at = offset_ + it_.current_index();
+		/* one document per line: a truncated line swallows the next one */
+		if (raw.find('\n') < raw.find_last_not_of(" \t\r\n")) {
+			next_ = at;
+			end_batch(true);
+			continue;
+		}
+
+		++docs_;
+		try {
+			cb(doc);
+		} catch (const simdjson::simdjson_error &e) {
+			report(e.what(), raw);
+			/* the stream may lose track after a half-consumed document, restart it on the next line */
+			next_ = std::min(input_.find('\n', at), input_.size() - 1) + 1;
+			end_batch(false);
+			continue;
+		}
+		done_ = at + raw.size();
+		++it_;
+		return true;
+	}
+}
+
+/*
+ * Calls `cb` for each document of newline-delimited `input` (see
+ * DocumentCursor), and returns the number of documents.
+ */
+template<typename F>
+size_t for_each_document(sj::parser &parser, std::string_view input, F &&cb, bool quiet = false, size_t batch_size = sj::DEFAULT_BATCH_SIZE)
+{
+	DocumentCursor cursor(parser, input, quiet, batch_size);
+	while (cursor.next(cb)) {
+	}
+	return cursor.docs();
+}
+
+void account_step(Result &r, ts_time ts, fp_seconds time, double energy);
+void process_step(Result &r, const Measurement &prev, const Measurement &last, bool quiet = false);
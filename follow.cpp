@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "follow.hpp"
+
+static const constexpr size_t READ_CHUNK = 1 << 20;
+
+LogFollower::LogFollower(std::filesystem::path path, Callback cb, const MemoryBudget &budget)
+	: path_(std::move(path))
+	, cb_(std::move(cb))
+	, chunk_(std::min(READ_CHUNK, budget.window))
+	, batch_size_(budget.batch_size)
+{
+	fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", path_));
+	}
+}
+
+LogFollower::~LogFollower()
+{
+	close(fd_);
+}
+
+void LogFollower::drain(sj::parser &parser)
+{
+	for (;;) {
+		struct stat st;
+		if (fstat(fd_, &st) < 0) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to stat {}", path_));
+		}
+		if (st.st_size < offset_) {
+			fmt::print(stderr, "{} was truncated, reading from the start\n", path_);
+			offset_ = 0;
+			len_ = 0;
+			skipping_ = false;
+		}
+
+		if (buf_.size() < len_ + chunk_ + simdjson::SIMDJSON_PADDING) {
+			buf_.resize(len_ + chunk_ + simdjson::SIMDJSON_PADDING);
+		}
+
+		ssize_t n = pread(fd_, buf_.data() + len_, chunk_, offset_);
+		if (n < 0) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to read {}", path_));
+		}
+		if (n == 0) {
+			break;
+		}
+		offset_ += n;
+		len_ += n;
+
+		consume(parser);
+	}
+}
+
+void LogFollower::consume(sj::parser &parser)
+{
+	/* the rest of a line that was too long has been reported already */
+	if (skipping_) {
+		auto eol = static_cast<const char *>(memchr(buf_.data(), '\n', len_));
+		if (!eol) {
+			len_ = 0;
+			return;
+		}
+		size_t skip = eol - buf_.data() + 1;
+		std::memmove(buf_.data(), buf_.data() + skip, len_ - skip);
+		len_ -= skip;
+		skipping_ = false;
+	}
+
+	auto nl = static_cast<const char *>(memrchr(buf_.data(), '\n', len_));
+	if (!nl) {
+		if (len_ >= chunk_) {
+			report_parse_error("line too long", std::string_view(buf_.data(), len_).substr(0, 80));
+			skipped_ = offset_ - len_;
+			skipping_ = true;
+			len_ = 0;
+		}
+		return;
+	}
+	size_t complete = nl - buf_.data() + 1;
+
+	for_each_document(parser, {buf_.data(), complete}, [&](sj::document_reference doc) {
+		cb_(parse_measurement(doc));
+	}, false, batch_size_);
+
+	std::memmove(buf_.data(), buf_.data() + complete, len_ - complete);
+	len_ -= complete;
+}
+
+FollowLoop::FollowLoop()
+{
+	inotify_ = inotify_init1(IN_CLOEXEC);
+	if (inotify_ < 0) {
+		throw std::system_error(errno, std::generic_category(), "Failed to initialize inotify");
+	}
+}
+
+FollowLoop::~FollowLoop()
+{
+	close(inotify_);
+}
+
+void FollowLoop::add(LogFollower &log)
+{
+	int wd = inotify_add_watch(inotify_, log.path().c_str(), IN_MODIFY);
+	if (wd < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to watch {}", log.path()));
+	}
+	if (!watches_.emplace(wd, &log).second) {
+		throw std::runtime_error(fmt::format("{} is followed more than once", log.path()));
+	}
+}
+
+/* blocks `signals` for as long as it is in scope */
+struct SignalBlock
+{
+	sigset_t old;
+
+	explicit SignalBlock(const sigset_t &signals) { pthread_sigmask(SIG_BLOCK, &signals, &old); }
+	~SignalBlock() { pthread_sigmask(SIG_SETMASK, &old, nullptr); }
+};
+
+void FollowLoop::run(const std::function<void()> &drained, const volatile std::sig_atomic_t &stop)
+{
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	SignalBlock blocked(signals);
+
+	for (auto &[wd, log]: watches_) {
+		log->drain(parser_);
+	}
+	drained();
+
+	while (!stop) {
+		/* signals held back since `stop` was checked are delivered here, and interrupt the wait */
+		struct pollfd pfd = {inotify_, POLLIN, 0};
+		if (ppoll(&pfd, 1, nullptr, &blocked.old) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "Failed to wait for inotify events");
+		}
+
+		alignas(struct inotify_event) char events[4096];
+		ssize_t n = read(inotify_, events, sizeof(events));
+		if (n < 0) {
+			throw std::system_error(errno, std::generic_category(), "Failed to read inotify events");
+		}
+
+		/* a burst of writes to the same log coalesces into a single drain */
+		LogFollower *last = nullptr;
+		for (char *p = events; p < events + n; ) {
+			auto ev = reinterpret_cast<const struct inotify_event *>(p);
+			p += sizeof(struct inotify_event) + ev->len;
+
+			/* events have been lost, any of the logs may have grown */
+			if (ev->mask & IN_Q_OVERFLOW) {
+				for (auto &[wd, log]: watches_) {
+					log->drain(parser_);
+				}
+				break;
+			}
+
+			auto it = watches_.find(ev->wd);
+			if (it == watches_.end() || it->second == last) {
+				continue;
+			}
+			last = it->second;
+			last->drain(parser_);
+		}
+		drained();
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <csignal>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "budget.hpp"
+#include "energy.hpp"
+
+/*
+ * A liquidctl log that is being appended to, followed like `tail -f`
+ * (i.e. by descriptor: a rotated-away log keeps being followed).
+ *
+ * Only complete lines are parsed; a trailing partial document is kept
+ * until the rest of it is written (or dropped up to the next newline, if
+ * it outgrows the read chunk -- a line that long is not a measurement
+ * anyway).
+ */
+class LogFollower
+{
+public:
+	using Callback = std::function<void(const Measurement &)>;
+
+	LogFollower(std::filesystem::path path, Callback cb, const MemoryBudget &budget = {});
+	~LogFollower();
+
+	LogFollower(const LogFollower &) = delete;
+	LogFollower &operator=(const LogFollower &) = delete;
+
+	const std::filesystem::path &path() const { return path_; }
+
+	/* parses everything appended since the last call */
+	void drain(sj::parser &parser);
+
+	int fd() const { return fd_; }
+	/* the end of the last line parsed */
+	off_t offset() const { return skipping_ ? skipped_ : offset_ - len_; }
+	/* goes on from `offset`, the end of a line, rather than from the start */
+	void resume(off_t offset) { offset_ = offset; len_ = 0; skipping_ = false; }
+
+private:
+	void consume(sj::parser &parser);
+
+	std::filesystem::path path_;
+	Callback cb_;
+	int fd_ = -1;
+	off_t offset_ = 0;
+	size_t chunk_, batch_size_;
+
+	/* pending bytes, padded for simdjson */
+	std::vector<char> buf_;
+	size_t len_ = 0;
+	/* dropping the rest of a line that was too long, which starts at `skipped_` */
+	bool skipping_ = false;
+	off_t skipped_ = 0;
+};
+
+/*
+ * Services any number of followed logs from a single inotify event loop.
+ * Logs are drained one at a time, so they share a single parser.
+ */
+class FollowLoop
+{
+public:
+	FollowLoop();
+	~FollowLoop();
+
+	FollowLoop(const FollowLoop &) = delete;
+	FollowLoop &operator=(const FollowLoop &) = delete;
+
+	void add(LogFollower &log);
+
+	/*
+	 * Drains all logs, then keeps draining each log as it grows. Calls
+	 * `drained` whenever all data written so far has been consumed, the
+	 * first time after the existing contents. Returns once `stop` is set
+	 * (by a handler of SIGINT or SIGTERM, which are held back until the
+	 * loop waits for events, so that they cannot slip in between checking
+	 * `stop` and waiting).
+	 */
+	void run(const std::function<void()> &drained, const volatile std::sig_atomic_t &stop);
+
+private:
+	int inotify_ = -1;
+	std::unordered_map<int, LogFollower *> watches_;
+	sj::parser parser_;
+};
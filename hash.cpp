@@ -0,0 +1,84 @@
+#include <bit>
+#include <cstring>
+
+#include "hash.hpp"
+
+static const uint64_t P1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t P3 = 0x165667B19E3779F9ULL;
+static const uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+/* unaligned little-endian loads; the reference output is defined in those terms */
+static uint64_t read64(const char *p)
+{
+	uint64_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return std::endian::native == std::endian::little ? v : __builtin_bswap64(v);
+}
+
+static uint32_t read32(const char *p)
+{
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return std::endian::native == std::endian::little ? v : __builtin_bswap32(v);
+}
+
+static uint64_t round(uint64_t acc, uint64_t input)
+{
+	acc += input * P2;
+	acc = std::rotl(acc, 31);
+	return acc * P1;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t val)
+{
+	acc ^= round(0, val);
+	return acc * P1 + P4;
+}
+
+uint64_t xxh64(std::string_view data, uint64_t seed)
+{
+	const char *p = data.data(), *end = p + data.size();
+	uint64_t h;
+
+	if (data.size() >= 32) {
+		uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+		for (; p + 32 <= end; p += 32) {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+		h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+		h = merge_round(h, v1);
+		h = merge_round(h, v2);
+		h = merge_round(h, v3);
+		h = merge_round(h, v4);
+	} else {
+		h = seed + P5;
+	}
+
+	h += data.size();
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= round(0, read64(p));
+		h = std::rotl(h, 27) * P1 + P4;
+	}
+	if (p + 4 <= end) {
+		h ^= uint64_t(read32(p)) * P1;
+		h = std::rotl(h, 23) * P2 + P3;
+		p += 4;
+	}
+	for (; p < end; ++p) {
+		h ^= uint64_t(uint8_t(*p)) * P5;
+		h = std::rotl(h, 11) * P1;
+	}
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
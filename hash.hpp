@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/*
+ * XXH64 (https://xxhash.com/), a fast non-cryptographic hash: good for
+ * telling whether data has changed, worthless against anyone changing
+ * it on purpose.
+ */
+uint64_t xxh64(std::string_view data, uint64_t seed = 0);
@@ -0,0 +1,140 @@
+#include <cerrno>
+#include <charconv>
+#include <fstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "hwmon.hpp"
+
+namespace fs = std::filesystem;
+
+static std::filesystem::path find_hwmon(const fs::path &sysfs, std::string_view name)
+{
+	fs::path class_dir = sysfs / "class" / "hwmon";
+	std::error_code ec;
+	for (const auto &entry: fs::directory_iterator(class_dir, ec)) {
+		std::ifstream f(entry.path() / "name");
+		std::string line;
+		if (std::getline(f, line) && line == name) {
+			return entry.path();
+		}
+	}
+	throw std::runtime_error(
+		fmt::format(
+			"No hwmon device named \"{}\" found in {}",
+			name,
+			class_dir
+		));
+}
+
+static std::filesystem::path find_debugfs(const fs::path &sysfs, std::string_view name)
+{
+	/* corsair-psu names its debugfs directory "corsair-psu-<hid device>" */
+	std::error_code ec;
+	for (const auto &entry: fs::directory_iterator(sysfs / "kernel" / "debug", ec)) {
+		if (entry.path().filename().native().starts_with(fmt::format("{}-", name))) {
+			return entry.path();
+		}
+	}
+	return {};
+}
+
+static int open_attr(const fs::path &p)
+{
+	int fd = open(p.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", p));
+	}
+	return fd;
+}
+
+HwmonCollector::HwmonCollector(HwmonConfig config)
+	: config_(std::move(config))
+	, hwmon_(find_hwmon(config_.sysfs, config_.name))
+	, start_(std::chrono::steady_clock::now())
+{
+	power_fd_ = open_attr(hwmon_ / config_.power);
+
+	if (auto debugfs = find_debugfs(config_.sysfs, config_.name); !debugfs.empty()) {
+		uptime_fd_ = open_attr(debugfs / "uptime");
+		uptime_total_fd_ = open_attr(debugfs / "uptime_total");
+	} else {
+		fmt::print(stderr, "No {} debugfs entries, rollovers will not be detected\n", config_.name);
+	}
+}
+
+HwmonCollector::~HwmonCollector()
+{
+	for (int fd: { power_fd_, uptime_fd_, uptime_total_fd_ }) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+double HwmonCollector::read_attr(int fd, const char *what)
+{
+	char buf[32];
+	ssize_t n = pread(fd, buf, sizeof(buf), 0);
+	if (n < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to read {} of {}", what, hwmon_));
+	}
+
+	long value;
+	auto [end, ec] = std::from_chars(buf, buf + n, value);
+	if (ec != std::errc{}) {
+		throw std::runtime_error(
+			fmt::format(
+				"Bad {} of {}: \"{}\"",
+				what,
+				hwmon_,
+				std::string_view(buf, n)
+			));
+	}
+	return value;
+}
+
+Measurement HwmonCollector::sample()
+{
+	auto now = std::chrono::system_clock::now();
+	double pwr = read_attr(power_fd_, "power") / 1'000'000;
+
+	double uptime_cur, uptime_tot;
+	if (uptime_fd_ >= 0) {
+		uptime_cur = read_attr(uptime_fd_, "uptime");
+		uptime_tot = read_attr(uptime_total_fd_, "total uptime");
+	} else {
+		uptime_cur = uptime_tot = fp_seconds{std::chrono::steady_clock::now() - start_}.count();
+	}
+
+	return {
+		.stamp = std::chrono::time_point_cast<ts_time::duration>(now),
+		.uptime_cur = uptime_cur,
+		.uptime_tot = uptime_tot,
+		.pwr = pwr,
+	};
+}
+
+void HwmonCollector::run(const Callback &cb, const volatile std::sig_atomic_t &stop)
+{
+	/* absolute deadlines, so that the time spent sampling does not accumulate as drift */
+	auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(config_.interval);
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	while (!stop) {
+		cb(sample());
+
+		auto next = std::chrono::seconds{deadline.tv_sec} + std::chrono::nanoseconds{deadline.tv_nsec} + interval;
+		deadline.tv_sec = std::chrono::floor<std::chrono::seconds>(next).count();
+		deadline.tv_nsec = (next - std::chrono::floor<std::chrono::seconds>(next)).count();
+
+		while (!stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) { }
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <csignal>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+#include "energy.hpp"
+
+struct HwmonConfig
+{
+	/* root of the sysfs tree to look for the device in (a fake one in tests) */
+	std::filesystem::path sysfs = "/sys";
+	/* hwmon driver name to look for */
+	std::string name = "corsair-psu";
+	/* power attribute, in µW */
+	std::string power = "power1_input";
+	fp_seconds interval{0.5};
+};
+
+/*
+ * Samples a PSU through its hwmon driver rather than through liquidctl.
+ *
+ * All attributes are opened once and re-read with pread() at offset 0,
+ * which makes sysfs regenerate them, so a sample costs a few syscalls.
+ *
+ * Uptimes are only exposed by corsair-psu in debugfs; if that is not
+ * available, the time since the collector was started is used for both,
+ * which disables rollover detection.
+ */
+class HwmonCollector
+{
+public:
+	using Callback = std::function<void(const Measurement &)>;
+
+	explicit HwmonCollector(HwmonConfig config);
+	~HwmonCollector();
+
+	HwmonCollector(const HwmonCollector &) = delete;
+	HwmonCollector &operator=(const HwmonCollector &) = delete;
+
+	const std::filesystem::path &path() const { return hwmon_; }
+
+	Measurement sample();
+
+	/* samples every `interval` until `stop` is set (by a signal handler) */
+	void run(const Callback &cb, const volatile std::sig_atomic_t &stop);
+
+private:
+	double read_attr(int fd, const char *what);
+
+	HwmonConfig config_;
+	std::filesystem::path hwmon_;
+	int power_fd_ = -1;
+	int uptime_fd_ = -1;
+	int uptime_total_fd_ = -1;
+	std::chrono::steady_clock::time_point start_;
+};
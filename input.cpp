@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include <simdjson.h>
+
+#include "input.hpp"
+
+/* past a full window, read in small steps to find the end of the line without overshooting much */
+static const constexpr size_t LINE_READ = 64 << 10;
+
+InputWindows::InputWindows(const std::filesystem::path &path, size_t window)
+	: path_(path)
+	, window_(std::max<size_t>(window, 1))
+	, buf_(new char[2 * window_ + simdjson::SIMDJSON_PADDING])
+{
+	fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", path_));
+	}
+	posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+InputWindows::~InputWindows()
+{
+	close(fd_);
+}
+
+void InputWindows::read_some(size_t max)
+{
+	ssize_t n;
+	do {
+		n = read(fd_, buf_.get() + len_, max);
+	} while (n < 0 && errno == EINTR);
+	if (n < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to read {}", path_));
+	}
+	len_ += n;
+	eof_ = n == 0;
+}
+
+InputWindows::Window InputWindows::next()
+{
+	std::memmove(buf_.get(), buf_.get() + pos_, len_ - pos_);
+	len_ -= pos_;
+	pos_ = 0;
+
+	/* the buffer holds two windows, the second one only for the end of a line */
+	size_t capacity = 2 * window_, scanned = window_ - 1;
+	for (;;) {
+		if (len_ > scanned) {
+			auto nl = static_cast<const char *>(std::memchr(buf_.get() + scanned, '\n', len_ - scanned));
+			if (nl) {
+				pos_ = nl - buf_.get() + 1;
+				return {{buf_.get(), pos_}, true};
+			}
+			scanned = len_;
+		}
+		if (eof_) {
+			pos_ = len_;
+			return {{buf_.get(), pos_}, false};
+		}
+		if (len_ == capacity) {
+			pos_ = len_;
+			return {{buf_.get(), pos_}, true};
+		}
+		read_some(len_ < window_ ? window_ - len_ : std::min(LINE_READ, capacity - len_));
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+/*
+ * Reads a log a window at a time into a buffer padded for simdjson, so
+ * that logs of any size are processed in memory bounded by the window.
+ *
+ * A window is about `window` bytes and ends right after the first newline
+ * at or after that -- so a window boundary only depends on the content
+ * before it (InputCache blocks are windows of BLOCK_SIZE). The last window
+ * ends at the end of the file instead. A line that does not end within
+ * another `window` bytes is cut there; its parts are reported as broken
+ * documents.
+ */
+class InputWindows
+{
+public:
+	struct Window
+	{
+		std::string_view data;
+		/* ends at a newline past `window` bytes (or cuts a line), rather than at the end of the file */
+		bool cut;
+	};
+
+	InputWindows(const std::filesystem::path &path, size_t window);
+	~InputWindows();
+
+	InputWindows(const InputWindows &) = delete;
+	InputWindows &operator=(const InputWindows &) = delete;
+
+	/* the next window, valid until the next call; empty at the end of the file */
+	Window next();
+
+private:
+	void read_some(size_t max);
+
+	std::filesystem::path path_;
+	int fd_ = -1;
+	size_t window_;
+	bool eof_ = false;
+
+	/* not zeroed, so that only as much of it as the input needs is ever touched */
+	std::unique_ptr<char[]> buf_;
+	/* bytes in `buf_`, of which the first `pos_` have been returned */
+	size_t len_ = 0, pos_ = 0;
+};
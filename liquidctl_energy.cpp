@@ -0,0 +1,177 @@
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "energy.hpp"
+#include "liquidctl_energy.h"
+
+struct lce_accumulator
+{
+	Accumulator acc;
+	sj::parser parser;
+	/* pending bytes, padded for simdjson */
+	std::vector<char> buf;
+	size_t len = 0;
+	uint64_t documents = 0;
+	uint64_t parse_errors = 0;
+	std::string error;
+
+	lce_accumulator()
+	{
+		/* a library has no business printing */
+		acc.quiet = true;
+	}
+};
+
+/* runs `fn`, turning exceptions into status codes */
+template<typename F>
+static lce_status guarded(const lce_accumulator *acc, F &&fn)
+{
+	auto fail = [&](lce_status status, const char *what) {
+		try {
+			const_cast<lce_accumulator *>(acc)->error = what;
+		} catch (...) {
+		}
+		return status;
+	};
+
+	try {
+		fn();
+		return LCE_OK;
+	} catch (const std::bad_alloc &e) {
+		return fail(LCE_ERROR_OUT_OF_MEMORY, e.what());
+	} catch (const std::exception &e) {
+		return fail(LCE_ERROR_INTERNAL, e.what());
+	} catch (...) {
+		return fail(LCE_ERROR_INTERNAL, "unknown error");
+	}
+}
+
+lce_accumulator *lce_create(void)
+{
+	return new (std::nothrow) lce_accumulator;
+}
+
+void lce_destroy(lce_accumulator *acc)
+{
+	delete acc;
+}
+
+lce_status lce_feed_json_bytes(lce_accumulator *acc, const char *data, size_t len)
+{
+	if (!acc || (!data && len)) {
+		return LCE_ERROR_INVALID_ARGUMENT;
+	}
+
+	return guarded(acc, [&] {
+		if (acc->buf.size() < acc->len + len + simdjson::SIMDJSON_PADDING) {
+			acc->buf.resize(acc->len + len + simdjson::SIMDJSON_PADDING);
+		}
+		std::memcpy(acc->buf.data() + acc->len, data, len);
+		acc->len += len;
+
+		auto nl = static_cast<const char *>(memrchr(acc->buf.data(), '\n', acc->len));
+		if (!nl) {
+			return;
+		}
+		size_t complete = nl - acc->buf.data() + 1;
+
+		/* the complete lines are done with, whatever happens to them: the next call is not to see them again */
+		auto consume = [&] {
+			std::memmove(acc->buf.data(), acc->buf.data() + complete, acc->len - complete);
+			acc->len -= complete;
+		};
+
+		uint64_t parsed = 0;
+		try {
+			uint64_t docs = for_each_document(acc->parser, {acc->buf.data(), complete}, [&](sj::document_reference doc) {
+				/* valid JSON, but not a measurement (e.g. a timestamp that does not parse) */
+				Measurement m;
+				try {
+					m = parse_measurement(doc);
+				} catch (const std::runtime_error &) {
+					return;
+				}
+				acc->acc.feed(m);
+				++parsed;
+			}, true);
+			acc->documents += docs;
+			acc->parse_errors += docs - parsed;
+		} catch (...) {
+			consume();
+			throw;
+		}
+		consume();
+	});
+}
+
+lce_status lce_feed_measurement(lce_accumulator *acc, const lce_measurement *m)
+{
+	if (!acc || !m) {
+		return LCE_ERROR_INVALID_ARGUMENT;
+	}
+
+	return guarded(acc, [&] {
+		acc->acc.feed({
+			.stamp = ts_time{std::chrono::nanoseconds{m->stamp_ns}},
+			.uptime_cur = m->uptime_cur,
+			.uptime_tot = m->uptime_tot,
+			.pwr = m->pwr,
+		});
+	});
+}
+
+lce_status lce_snapshot(const lce_accumulator *acc, lce_totals *totals,
+			lce_bucket *buckets, size_t capacity, size_t *count)
+{
+	if (!acc || !totals || !count || (!buckets && capacity)) {
+		return LCE_ERROR_INVALID_ARGUMENT;
+	}
+
+	const Result &r = acc->acc.r;
+	*totals = {
+		.time_s = r.total.time.count(),
+		.energy_j = r.total.energy_j,
+		.rollovers = r.rollovers,
+		.power_losses = r.power_losses,
+		.bad = r.bad,
+		.documents = acc->documents,
+		.parse_errors = acc->parse_errors,
+	};
+
+	*count = r.buckets.size();
+	size_t i = 0;
+	for (auto it = r.buckets.begin(); it != r.buckets.end() && i < capacity; ++it, ++i) {
+		buckets[i] = {
+			.year = std::get<0>(it->first),
+			.month = std::get<1>(it->first),
+			.time_s = it->second.time.count(),
+			.energy_j = it->second.energy_j,
+		};
+	}
+
+	return *count > capacity ? LCE_ERROR_BUFFER_TOO_SMALL : LCE_OK;
+}
+
+lce_status lce_merge(lce_accumulator *dst, const lce_accumulator *src)
+{
+	if (!dst || !src || dst == src) {
+		return LCE_ERROR_INVALID_ARGUMENT;
+	}
+
+	return guarded(dst, [&] {
+		merge(dst->acc.r, src->acc.r);
+		dst->documents += src->documents;
+		dst->parse_errors += src->parse_errors;
+	});
+}
+
+const char *lce_last_error(const lce_accumulator *acc)
+{
+	if (!acc) {
+		return "no accumulator";
+	}
+	return acc->error.c_str();
+}
@@ -0,0 +1,102 @@
+/*
+ * C interface to the liquidctl-energy accounting core, for feeding
+ * measurements in-process from other runtimes.
+ *
+ * All memory passed in is owned by the caller and is not retained past
+ * the call. No function throws or aborts on bad input; failures are
+ * reported through the return value, and lce_last_error() describes the
+ * last one.
+ *
+ * Monthly buckets are in the local time zone of the process.
+ * An accumulator must not be used from several threads at once.
+ */
+
+#ifndef LIQUIDCTL_ENERGY_H
+#define LIQUIDCTL_ENERGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define LCE_API __attribute__((visibility("default")))
+#else
+#define LCE_API
+#endif
+
+typedef enum lce_status {
+	LCE_OK = 0,
+	LCE_ERROR_INVALID_ARGUMENT,
+	LCE_ERROR_BUFFER_TOO_SMALL,
+	LCE_ERROR_OUT_OF_MEMORY,
+	LCE_ERROR_INTERNAL,
+} lce_status;
+
+typedef struct lce_accumulator lce_accumulator;
+
+typedef struct lce_measurement {
+	int64_t stamp_ns;	/* since the Unix epoch */
+	double uptime_cur;	/* s */
+	double uptime_tot;	/* s */
+	double pwr;		/* W */
+} lce_measurement;
+
+typedef struct lce_totals {
+	double time_s;
+	double energy_j;
+	uint32_t rollovers;
+	uint32_t power_losses;
+	uint32_t bad;		/* non-zero if any inconsistent measurement was seen */
+	uint64_t documents;	/* JSON documents fed */
+	uint64_t parse_errors;	/* ...of which could not be parsed */
+} lce_totals;
+
+typedef struct lce_bucket {
+	int32_t year;
+	int32_t month;		/* 1-12 */
+	double time_s;
+	double energy_j;
+} lce_bucket;
+
+/* returns NULL if out of memory */
+LCE_API lce_accumulator *lce_create(void);
+LCE_API void lce_destroy(lce_accumulator *acc);
+
+/*
+ * Feeds a chunk of a liquidctl log (newline-delimited JSON documents).
+ * Chunks may split documents anywhere; an incomplete trailing line is
+ * kept until the next call. Unparseable documents are counted and
+ * skipped.
+ */
+LCE_API lce_status lce_feed_json_bytes(lce_accumulator *acc, const char *data, size_t len);
+
+/* feeds a single measurement, which must not be older than the previous one */
+LCE_API lce_status lce_feed_measurement(lce_accumulator *acc, const lce_measurement *m);
+
+/*
+ * Copies the current totals and up to `capacity` buckets, in
+ * chronological order, and stores the number of buckets in `*count`.
+ * If `capacity` is too small, the totals and `*count` are still filled
+ * in and LCE_ERROR_BUFFER_TOO_SMALL is returned. `buckets` may be NULL
+ * if `capacity` is 0.
+ */
+LCE_API lce_status lce_snapshot(const lce_accumulator *acc, lce_totals *totals,
+				lce_bucket *buckets, size_t capacity, size_t *count);
+
+/*
+ * Adds the results accumulated by `src` to `dst`, e.g. to sum up
+ * several hosts. `src` is left as is.
+ */
+LCE_API lce_status lce_merge(lce_accumulator *dst, const lce_accumulator *src);
+
+/* describes the last failure on `acc`, valid until the next call on it */
+LCE_API const char *lce_last_error(const lce_accumulator *acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIQUIDCTL_ENERGY_H */
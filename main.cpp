@@ -1,184 +1,663 @@
 #include <iostream>
 #include <filesystem>
 #include <chrono>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include <fmt/format.h>
 #include <fmt/std.h>
 #include <fmt/chrono.h>
 #include <argparse/argparse.hpp>
-#include <date/date.h>
 #include <simdjson.h>
 
-#include "svstream.hpp"
+#include "energy.hpp"
+#include "alerts.hpp"
+#include "approx.hpp"
+#include "archive.hpp"
+#include "arrow.hpp"
+#include "budget.hpp"
+#include "cache.hpp"
+#include "check.hpp"
+#include "compact.hpp"
+#include "follow.hpp"
+#include "hwmon.hpp"
+#include "input.hpp"
+#include "measurements.hpp"
+#include "project.hpp"
+#include "rollup.hpp"
+#include "snapshot.hpp"
+#include "sqlite.hpp"
+#include "state.hpp"
+#include "top.hpp"
+#ifdef LIQUIDCTL_ENERGY_COUNT_ALLOCATIONS
+#include "alloc_count.hpp"
+#endif
 
 using std::filesystem::path;
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
-using simdjson::padded_string;
-namespace sj = simdjson::ondemand;
-
-using ts_time = std::chrono::sys_time<std::chrono::nanoseconds>;
-using ts_zoned = std::chrono::zoned_time<std::chrono::nanoseconds>;
-using fp_seconds = std::chrono::duration<double>;
+static void print_load_states(const GroupResult &g)
+{
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		fmt::print(
+			"{:>16} {:>5.1f}% of the time, {:>6.2f} kWh\n",
+			load_state_name(LoadState(s)),
+			g.time.count() ? 100 * g.load_time[s] / g.time : 0,
+			g.load_energy_j[s] / 3600 / 1000
+		);
+	}
+}
 
-struct Measurement
+static void print_result(const Result &r, bool load_states)
 {
-	ts_time stamp;
-	double uptime_cur, uptime_tot;
-	double pwr;
-};
+	fmt::print("Total rollover events: {}\n", r.rollovers);
+	fmt::print("Total power loss events: {}\n\n", r.power_losses);
+	fmt::print("-----------------------------------\n");
+
+	for (const auto &i: r.buckets) {
+		/* TODO: fmtlib does not yet support %j for durations
+		 *       (https://github.com/fmtlib/fmt/issues/3643) */
+		fmt::print(
+			"{:04d}-{:02d} uptime is {:2}d {:.1%Hh %Mm %Ss}\n",
+			std::get<0>(i.first),
+			std::get<1>(i.first),
+			std::chrono::floor<std::chrono::days>(i.second.time).count(),
+			i.second.time
+		);
+		fmt::print("        energy is {:>6.2f} kWh\n", i.second.energy_kwh());
+		fmt::print("           ... or {:>6.2f} ₽\n", i.second.energy_kwh() * i.second.COST_KWH);
+		if (load_states) {
+			print_load_states(i.second);
+		}
+	}
 
-struct GroupKey : public std::tuple<int, int>
+	fmt::print("----------------------------------\n");
+
+	/* TODO: fmtlib does not yet support %j for durations
+	 *       (https://github.com/fmtlib/fmt/issues/3643) */
+	fmt::print(
+		"Total uptime is {:3}d {:.1%Hh %Mm %Ss}\n",
+		std::chrono::floor<std::chrono::days>(r.total.time).count(),
+		r.total.time
+	);
+	fmt::print("Total energy is {:>8.2f} kWh\n", r.total.energy_kwh());
+	fmt::print("         ... or {:>8.2f} ₽\n", r.total.energy_kwh() * r.total.COST_KWH);
+	if (load_states) {
+		print_load_states(r.total);
+	}
+}
+
+static void print_approx(const ApproxResult &r, unsigned k)
 {
-public:
-	GroupKey(auto &&... ts)
-		: std::tuple<int, int>(std::forward<decltype(ts)>(ts)...)
-	{ }
+	fmt::print("Sampled {} of {} blocks (every {}), give or take a 95% confidence interval\n", r.sampled, r.blocks, k);
+	fmt::print("----------------------------------\n");
 
-	static GroupKey from_time(ts_time ts);
-};
+	/* TODO: fmtlib does not yet support %j for durations
+	 *       (https://github.com/fmtlib/fmt/issues/3643) */
+	fp_seconds time{r.time_s.value};
+	fmt::print(
+		"Total uptime is {:3}d {:.1%Hh %Mm %Ss} ± {:.0f} s\n",
+		std::chrono::floor<std::chrono::days>(time).count(),
+		time,
+		r.time_s.margin
+	);
+	double kwh = r.energy_j.value / 3600 / 1000, kwh_margin = r.energy_j.margin / 3600 / 1000;
+	fmt::print("Total energy is {:>8.2f} kWh ± {:.2f} kWh\n", kwh, kwh_margin);
+	fmt::print("         ... or {:>8.2f} ₽ ± {:.2f} ₽\n", kwh * GroupResult::COST_KWH, kwh_margin * GroupResult::COST_KWH);
+}
 
-struct GroupResult
+static void print_top(TopPeriods &top, const TopQuery &query)
 {
-	static const constexpr double COST_KWH = 7.79;
-	fp_seconds time;
-	double energy_j;
-	double energy_kwh() const { return energy_j / 3600 / 1000; }
-};
+	static const char *const what[] = {"days", "hours", "sessions"};
+
+	auto periods = top.finish();
+	fmt::print("----------------------------------\n");
+	fmt::print("Top {} {} by energy:\n", periods.size(), what[query.by]);
+	for (const auto &p: periods) {
+		fmt::print("{:>42}: {:>6.2f} kWh, {:>6.2f} ₽\n", top.label(p), p.energy_kwh(), p.energy_kwh() * GroupResult::COST_KWH);
+	}
+	fmt::print("(the energy between two measurements counts towards the period of the earlier one,\n"
+		   " as in monthly buckets, and that of a power loss towards the period after it)\n");
+}
 
-struct Result
+/*
+ * Runs the input through the straightforward pipeline (date::parse for
+ * timestamps, a bucket lookup per step) and checks that the fast one has
+ * produced the very same result.
+ */
+static bool cross_check(sj::parser &parser, const path &input_path, const MemoryBudget &budget, const Result &fast)
 {
-	GroupResult total;
-	std::map<GroupKey, GroupResult> buckets;
-	unsigned rollovers;
-	bool bad;
-};
+	Accumulator reference;
+	reference.reference = true;
+	reference.quiet = true;
 
-double parse_item(sj::object obj, std::string_view unit)
+	/* errors have already been reported */
+	InputWindows input(input_path, budget.window);
+	for (const auto &m: Measurements(input, parser, true, budget.batch_size, parse_timestamp)) {
+		reference.feed(m);
+	}
+
+	auto diffs = compare_results(reference.r, fast);
+	for (const auto &d: diffs) {
+		fmt::print(stderr, "Cross-check mismatch (reference vs. fast): {}\n", d);
+	}
+	return diffs.empty();
+}
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int)
 {
-	auto value = obj.find_field("value").get_double().value();
-	if (obj.find_field("unit").get_string() != unit) {
-		throw std::runtime_error(
-			fmt::format(
-				"Bad item: {}, expected unit: \"{}\"",
-				obj.raw_json().value(),
-				unit
-			));
-	}
-	return value;
+	interrupted = 1;
 }
 
-ts_time parse_timestamp(std::string_view s)
+/* `liquidctl-energy check`: one line of JSON per log */
+static int check_main(int argc, char **argv)
 {
-	isvstream ss{s};
-	ss.exceptions(std::ios::failbit);
+	argparse::ArgumentParser args("liquidctl-energy check");
+	args.add_description("Validates logs and summarizes what they hold, without accounting them.");
+	args.add_argument("input")
+		.help("liquidctl logs")
+		.nargs(argparse::nargs_pattern::at_least_one)
+		.action([](const std::string &value) {
+			return path(value);
+		});
+	args.add_argument("--gap")
+		.help("report steps between timestamps longer than this many seconds as gaps")
+		.default_value(60.0)
+		.scan<'g', double>();
+	args.add_argument("--stats")
+		.help("report processing throughput to stderr")
+		.default_value(false)
+		.implicit_value(true);
 
-	ts_time ret;
-	// 2023-05-31T00:13:57,906371842+03:00
-	ss >> date::parse("%FT%T%Ez", ret);
+	try {
+		args.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cerr << err.what() << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
 
-	return ret;
+	auto input_paths = args.get<std::vector<path>>("input");
+	if (input_paths.empty()) {
+		std::cerr << "Input logs must be given" << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
+
+	/* also catches NaN, and gaps too long for a difference of timestamps */
+	fp_seconds gap{args.get<double>("--gap")};
+	if (!(gap.count() > 0 && gap < ts_time::duration::max())) {
+		std::cerr << "--gap must be greater than 0, and short enough for a difference of timestamps" << std::endl;
+		std::exit(1);
+	}
+
+	bool ok = true;
+	size_t total_docs = 0, total_bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (const auto &input_path: input_paths) {
+		LogCheck c = check_log(input_path, gap);
+		fmt::print("{}\n", check_json(input_path, c));
+		ok &= c.ok();
+		total_docs += c.docs;
+		total_bytes += c.bytes;
+	}
+
+	if (args.get<bool>("--stats")) {
+		fp_seconds elapsed = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr,
+			   "Checked {} documents ({:.1f} MB) in {:.3f} s: {:.1f} MB/s, {:.0f} ns/document\n",
+			   total_docs,
+			   total_bytes / 1e6,
+			   elapsed.count(),
+			   total_bytes / 1e6 / elapsed.count(),
+			   elapsed.count() * 1e9 / total_docs
+		);
+	}
+	return ok ? 0 : 1;
 }
 
-GroupKey GroupKey::from_time(ts_time ts)
+/* `liquidctl-energy query`: power over a span of time, from a --compact export */
+static int query_main(int argc, char **argv)
 {
-	static auto zone = std::chrono::current_zone();
+	argparse::ArgumentParser args("liquidctl-energy query");
+	args.add_description("Summarizes power over a span of time from a file written with --compact.");
+	args.add_argument("file")
+		.help("compact measurement file")
+		.action([](const std::string &value) {
+			return path(value);
+		});
+	args.add_argument("--since")
+		.help("from this time on (as in the logs, e.g. 2023-05-01T00:00:00+03:00)");
+	args.add_argument("--until")
+		.help("...and up to this time");
+	args.add_argument("--source")
+		.help("only measurements from this input log (as it was given to --compact)");
+	args.add_argument("--stats")
+		.help("report how blocks were got at, and the time taken, to stderr")
+		.default_value(false)
+		.implicit_value(true);
+
+	try {
+		args.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cerr << err.what() << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
 
-	auto ts_local = ts_zoned{zone, ts}.get_local_time();
-	auto ymd = std::chrono::year_month_day{ std::chrono::floor<std::chrono::days>(ts_local) };
-	return {(int)ymd.year(), (unsigned)ymd.month()};
+	ts_time since = ts_time::min(), until = ts_time::max();
+	try {
+		if (auto s = args.present("--since")) {
+			since = parse_timestamp(*s);
+		}
+		if (auto s = args.present("--until")) {
+			until = parse_timestamp(*s);
+		}
+	} catch (const std::exception &) {
+		std::cerr << "--since and --until take timestamps like 2023-05-01T00:00:00+03:00" << std::endl;
+		std::exit(1);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	CompactReader reader(args.get<path>("file"));
+
+	uint32_t source = CompactReader::SOURCES;
+	if (auto name = args.present("--source")) {
+		auto it = std::find(reader.sources().begin(), reader.sources().end(), *name);
+		if (it == reader.sources().end()) {
+			std::cerr << fmt::format("No source {} in {}", *name, args.get<path>("file")) << std::endl;
+			std::exit(1);
+		}
+		source = it - reader.sources().begin();
+	}
+
+	CompactReader::Scan scan;
+	PowerSummary s = reader.query(since, until, source, scan);
+
+	fmt::print("Samples: {}\n", s.samples);
+	if (s.samples) {
+		fmt::print("   From: {}\n", s.first);
+		fmt::print("     To: {}\n", s.last);
+		fmt::print("  Power: {:.2f} W min, {:.2f} W mean, {:.2f} W max\n", s.min, s.mean(), s.max);
+	}
+
+	if (args.get<bool>("--stats")) {
+		fp_seconds elapsed = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr,
+			   "Blocks: {} skipped, {} from zone maps, {} decoded, in {:.3f} s\n",
+			   scan.skipped, scan.summarized, scan.decoded, elapsed.count()
+		);
+	}
+	return 0;
 }
 
-void account_step(Result &r, ts_time ts, fp_seconds time, double energy)
+/* `liquidctl-energy archive`: LOG.zst next to each LOG */
+static int archive_main(int argc, char **argv)
 {
-	static GroupKey last_key{};
-	static GroupResult *last_bucket{};
+	argparse::ArgumentParser args("liquidctl-energy archive");
+	args.add_description("Compresses logs into seekable zstd archives, indexed by timestamp, for `liquidctl-energy extract`.");
+	args.add_argument("input")
+		.help("liquidctl logs (each one is archived to the same path with .zst added)")
+		.nargs(argparse::nargs_pattern::at_least_one)
+		.action([](const std::string &value) {
+			return path(value);
+		});
+	args.add_argument("--level")
+		.help("zstd compression level")
+		.default_value(ZSTD_CLEVEL_DEFAULT)
+		.scan<'i', int>();
+	args.add_argument("--frame-size")
+		.help("compress about this many bytes (K, M, G suffixes) at a time, the least that extract decompresses")
+		.default_value("1M"s);
+	args.add_argument("--stats")
+		.help("report compression ratio and throughput to stderr")
+		.default_value(false)
+		.implicit_value(true);
 
-	auto key = GroupKey::from_time(ts);
-	if (key != last_key) {
-		last_key = key;
-		last_bucket = &r.buckets[key];
+	try {
+		args.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cerr << err.what() << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
 	}
 
-	r.total.time += time;
-	r.total.energy_j += energy;
-	last_bucket->time += time;
-	last_bucket->energy_j += energy;
+	auto input_paths = args.get<std::vector<path>>("input");
+	if (input_paths.empty()) {
+		std::cerr << "Input logs must be given" << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
+	size_t frame_size;
+	try {
+		frame_size = parse_size(args.get<std::string>("--frame-size"));
+	} catch (const std::runtime_error &err) {
+		std::cerr << err.what() << std::endl;
+		std::exit(1);
+	}
+	/* a frame may run on up to another frame size to the end of a line, and its size must fit 32 bits */
+	if (!frame_size || frame_size > 1024 * 1024 * 1024) {
+		std::cerr << "--frame-size must be between 1 and 1G" << std::endl;
+		std::exit(1);
+	}
+
+	uint64_t total_raw = 0, total_size = 0, total_frames = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (const auto &input_path: input_paths) {
+		auto frames = archive_log(input_path, input_path.native() + ".zst", args.get<int>("--level"), frame_size);
+		for (const auto &f: frames) {
+			total_raw += f.raw_size;
+			total_size += f.size;
+		}
+		total_frames += frames.size();
+	}
+
+	if (args.get<bool>("--stats")) {
+		fp_seconds elapsed = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr,
+			   "Archived {:.1f} MB into {:.1f} MB ({:.1f}x) in {} frames, in {:.3f} s: {:.1f} MB/s\n",
+			   total_raw / 1e6,
+			   total_size / 1e6,
+			   total_size ? double(total_raw) / total_size : 0,
+			   total_frames,
+			   elapsed.count(),
+			   total_raw / 1e6 / elapsed.count()
+		);
+	}
+	return 0;
 }
 
-void process_step(Result &r, const Measurement &prev, const Measurement &last)
+/* `liquidctl-energy extract`: the lines of archives in a span of time, to stdout */
+static int extract_main(int argc, char **argv)
 {
-	fp_seconds delta_wall{last.stamp - prev.stamp};
-	fp_seconds delta_uptime_tot{last.uptime_tot - prev.uptime_tot};
-	fp_seconds delta_uptime_cur{last.uptime_cur - prev.uptime_cur};
-	fp_seconds uptime{last.uptime_cur};
+	argparse::ArgumentParser args("liquidctl-energy extract");
+	args.add_description("Writes out the lines of archives made with `liquidctl-energy archive`, or those within a\n"
+			     "span of time, decompressing only the parts of the archives that it overlaps.");
+	args.add_argument("input")
+		.help("seekable zstd archives")
+		.nargs(argparse::nargs_pattern::at_least_one)
+		.action([](const std::string &value) {
+			return path(value);
+		});
+	args.add_argument("--since")
+		.help("from this time on (as in the logs, e.g. 2023-05-01T00:00:00+03:00)");
+	args.add_argument("--until")
+		.help("...and up to this time");
+	args.add_argument("--jobs")
+		.help("decompress on this many threads")
+		.default_value(std::max(1u, std::thread::hardware_concurrency()))
+		.scan<'u', unsigned>();
+	args.add_argument("--stats")
+		.help("report how frames were got at, and the time taken, to stderr")
+		.default_value(false)
+		.implicit_value(true);
 
-	bool delta_uptime_bad = (
-		delta_uptime_tot.count() < uptime.count()
-	);
+	try {
+		args.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cerr << err.what() << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
 
-	if (std::abs(delta_wall.count() - delta_uptime_tot.count()) < 2) {
-		/* OK */
-	} else if (std::abs(delta_uptime_tot.count() - delta_uptime_cur.count()) < 1) {
-		/* imprecise wall time recorded, but no rollover has occurred -- OK for now */
-	} else if (delta_wall.count() > uptime.count()) {
-		fmt::print(""
-			   "Rollover: at   {} uptime_cur={} uptime_tot={}\n"
-			   "          prev {} uptime_cur={} uptime_tot={}\n"
-			   "          wall clock delta: {}\n"
-			   "              uptime delta: t. {}{}\n"
-			   "                    uptime: {}\n"
-			,
-			   last.stamp, last.uptime_cur, last.uptime_tot,
-			   prev.stamp, prev.uptime_cur, prev.uptime_tot,
-			   delta_wall,
-			   delta_uptime_bad ? "(invalid) " : "", delta_uptime_tot,
-			   uptime
-		);
+	auto input_paths = args.get<std::vector<path>>("input");
+	if (input_paths.empty()) {
+		std::cerr << "Archives must be given" << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
+	if (args.get<unsigned>("--jobs") == 0) {
+		std::cerr << "--jobs must be at least 1" << std::endl;
+		std::exit(1);
+	}
+
+	ts_time since = ts_time::min(), until = ts_time::max();
+	try {
+		if (auto s = args.present("--since")) {
+			since = parse_timestamp(*s);
+		}
+		if (auto s = args.present("--until")) {
+			until = parse_timestamp(*s);
+		}
+	} catch (const std::exception &) {
+		std::cerr << "--since and --until take timestamps like 2023-05-01T00:00:00+03:00" << std::endl;
+		std::exit(1);
+	}
+
+	ArchiveReader::Scan scan;
+	auto start = std::chrono::steady_clock::now();
 
-		++r.rollovers;
-		if (delta_uptime_bad) {
-			/* total uptime was not properly updated -- assuming a power loss has occurred, use only this measurement */
-			account_step(r, last.stamp, uptime, last.pwr * uptime.count());
-			return;
-		} else {
-			/* total uptime was updated -- use that delta instead of the wall clock delta */
-			delta_wall = delta_uptime_tot;
-		}
-	} else {
-		fmt::print(""
-			   "!!! INCONSISTENT MEASUREMENT !!!"
-			   "          at   {} uptime_cur={} uptime_tot={}\n"
-			   "          prev {} uptime_cur={} uptime_tot={}\n"
-			   "          wall clock delta: {}\n"
-			   "              uptime delta: t. {}{}, cur. {}\n"
-			   "                    uptime: {}\n"
-			,
-			   last.stamp, last.uptime_cur, last.uptime_tot,
-			   prev.stamp, prev.uptime_cur, prev.uptime_tot,
-			   delta_wall,
-			   delta_uptime_bad ? "(invalid) " : "", delta_uptime_tot, delta_uptime_cur,
-			   uptime
+	for (const auto &input_path: input_paths) {
+		ArchiveReader reader(input_path);
+		if (!reader.indexed() && (args.present("--since") || args.present("--until"))) {
+			fmt::print(stderr, "{} has no timestamp index, all of it is decompressed\n", input_path);
+		}
+		reader.extract(since, until, args.get<unsigned>("--jobs"), stdout, scan);
+	}
+	if (std::fflush(stdout) != 0) {
+		throw std::system_error(errno, std::generic_category(), "Failed to write out lines");
+	}
+
+	if (args.get<bool>("--stats")) {
+		fp_seconds elapsed = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr,
+			   "Frames: {} skipped, {} whole, {} filtered by line; {:.1f} MB out in {:.3f} s\n",
+			   scan.skipped, scan.whole, scan.filtered, scan.bytes / 1e6, elapsed.count()
 		);
+	}
+	return 0;
+}
 
-		r.bad = true;
-		return;
+/* `liquidctl-energy project`: logs cut down to what is read of them, to stdout */
+static int project_main(int argc, char **argv)
+{
+	argparse::ArgumentParser args("liquidctl-energy project");
+	args.add_description("Writes out logs with only the timestamps and the device status items that are read of\n"
+			     "them, without whitespace. The result accounts exactly like the original logs.");
+	args.add_argument("input")
+		.help("liquidctl logs")
+		.nargs(argparse::nargs_pattern::at_least_one)
+		.action([](const std::string &value) {
+			return path(value);
+		});
+	args.add_argument("--device")
+		.help("keep devices with this description (may be repeated; default: the one the accounting reads)")
+		.append();
+	args.add_argument("--key")
+		.help("keep status items with this key (may be repeated; default: the ones the accounting reads)")
+		.append();
+	args.add_argument("--stats")
+		.help("report the size reduction and throughput to stderr")
+		.default_value(false)
+		.implicit_value(true);
+
+	try {
+		args.parse_args(argc, argv);
+	} catch (const std::runtime_error &err) {
+		std::cerr << err.what() << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
 	}
 
-	account_step(r, prev.stamp, delta_wall, (prev.pwr + last.pwr) * delta_wall.count() / 2);
+	auto input_paths = args.get<std::vector<path>>("input");
+	if (input_paths.empty()) {
+		std::cerr << "Input logs must be given" << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
+
+	Projection p{
+		.devices = {"Corsair HX1000i"},
+		.keys = {"Current uptime", "Total uptime", "Estimated input power"},
+	};
+	if (args.is_used("--device")) {
+		p.devices = args.get<std::vector<std::string>>("--device");
+	}
+	if (args.is_used("--key")) {
+		p.keys = args.get<std::vector<std::string>>("--key");
+	}
+
+	ProjectStats stats;
+	auto start = std::chrono::steady_clock::now();
+
+	for (const auto &input_path: input_paths) {
+		project_log(input_path, p, stdout, stats);
+	}
+	if (std::fflush(stdout) != 0) {
+		throw std::system_error(errno, std::generic_category(), "Failed to write out documents");
+	}
+
+	if (args.get<bool>("--stats")) {
+		fp_seconds elapsed = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr,
+			   "Projected {} documents ({} broken, kept as they are) from {:.1f} MB to {:.1f} MB ({:.1f}x) in {:.3f} s: {:.1f} MB/s\n",
+			   stats.docs,
+			   stats.broken,
+			   stats.bytes_in / 1e6,
+			   stats.bytes_out / 1e6,
+			   stats.bytes_out ? double(stats.bytes_in) / stats.bytes_out : 0,
+			   elapsed.count(),
+			   stats.bytes_in / 1e6 / elapsed.count()
+		);
+	}
+	return 0;
 }
 
 int main(int argc, char **argv)
 {
 	std::locale::global(std::locale(""));
 
+	/* by hand: argparse only tells subcommands apart once the inputs are all taken */
+	if (argc > 1 && argv[1] == "check"sv) {
+		return check_main(argc - 1, argv + 1);
+	}
+	if (argc > 1 && argv[1] == "query"sv) {
+		return query_main(argc - 1, argv + 1);
+	}
+	if (argc > 1 && argv[1] == "archive"sv) {
+		return archive_main(argc - 1, argv + 1);
+	}
+	if (argc > 1 && argv[1] == "extract"sv) {
+		return extract_main(argc - 1, argv + 1);
+	}
+	if (argc > 1 && argv[1] == "project"sv) {
+		return project_main(argc - 1, argv + 1);
+	}
+
 	argparse::ArgumentParser args("liquidctl-energy");
+	args.add_epilog("Run `liquidctl-energy check --help` for validating logs without accounting them,\n"
+			"`liquidctl-energy query --help` for querying a --compact export, and\n"
+			"`liquidctl-energy project --help`, `liquidctl-energy archive --help` and\n"
+			"`liquidctl-energy extract --help` for keeping raw logs.");
 	args.add_argument("input")
+		.help("liquidctl logs (each one is accounted separately)")
+		.nargs(argparse::nargs_pattern::any)
 		.action([](const std::string &value) {
 			return path(value);
 		});
+	args.add_argument("-f", "--follow")
+		.help("keep reading the inputs as they grow, until interrupted")
+		.default_value(false)
+		.implicit_value(true);
+	args.add_argument("--stats")
+		.help("report processing throughput and peak memory use to stderr")
+		.default_value(false)
+		.implicit_value(true);
+	args.add_argument("--load-states")
+		.help("also split uptime and energy into idle, normal and peak load, as told apart by the power")
+		.default_value(false)
+		.implicit_value(true);
+	args.add_argument("--top")
+		.help("also list this many costliest periods")
+		.scan<'u', size_t>();
+	args.add_argument("--top-by")
+		.help("...out of days, hours or sessions (between PSU power cycles)")
+		.default_value("day"s);
+	args.add_argument("--top-since")
+		.help("...counting energy from this time on (as in the logs, e.g. 2023-05-01T00:00:00+03:00)");
+	args.add_argument("--top-until")
+		.help("...and up to this time");
+	args.add_argument("--cross-check")
+		.help("also process inputs with the reference implementation and fail if the results differ")
+		.default_value(false)
+		.implicit_value(true);
+	args.add_argument("--hwmon")
+		.help("sample the PSU through its hwmon driver instead of reading logs, until interrupted")
+		.default_value(false)
+		.implicit_value(true);
+	args.add_argument("--hwmon-sysfs")
+		.help("sysfs tree to find the hwmon device in")
+		.default_value("/sys"s);
+	args.add_argument("--hwmon-power")
+		.help("hwmon attribute to read power from, in µW")
+		.default_value("power1_input"s);
+	args.add_argument("--interval")
+		.help("hwmon sampling interval, in seconds")
+		.default_value(0.5)
+		.scan<'g', double>();
+	args.add_argument("--alert-power")
+		.help("alert when input power stays above this many W (follow and hwmon modes)")
+		.scan<'g', double>();
+	args.add_argument("--alert-power-for")
+		.help("...for at least this many seconds")
+		.default_value(0.0)
+		.scan<'g', double>();
+	args.add_argument("--alert-daily-kwh")
+		.help("alert when energy used within a day exceeds this many kWh (follow and hwmon modes)")
+		.scan<'g', double>();
+	args.add_argument("--alert-rollover")
+		.help("alert on rollover and power loss events (follow and hwmon modes)")
+		.default_value(false)
+		.implicit_value(true);
+	args.add_argument("--alert-exec")
+		.help("run this shell command for each alert (details are passed in LIQUIDCTL_ENERGY_* variables)");
+	args.add_argument("--alert-fifo")
+		.help("write a line to this FIFO for each alert");
+	args.add_argument("--arrow-measurements")
+		.help("export parsed measurements to this file, in the Arrow IPC (Feather v2) format");
+	args.add_argument("--arrow-buckets")
+		.help("export monthly buckets to this file, in the Arrow IPC (Feather v2) format");
+	args.add_argument("--compact")
+		.help("export parsed measurements to this file, in a compact block format for `liquidctl-energy query`");
+	args.add_argument("--sqlite")
+		.help("write buckets and sessions into this SQLite database (updated in place in follow and hwmon modes)");
+	args.add_argument("--sqlite-series")
+		.help("...and power downsampled to this many seconds")
+		.default_value(0.0)
+		.scan<'g', double>();
+	args.add_argument("--cache")
+		.help("keep processing state in this directory, to only process what has changed in the inputs since the last run");
+	args.add_argument("--state")
+		.help("keep the state of followed logs in this file, to go on from where it was when restarted (follow mode)");
+	args.add_argument("--state-interval")
+		.help("...saving it this often, in seconds (and on exit)")
+		.default_value(60.0)
+		.scan<'g', double>();
+	args.add_argument("--state-records")
+		.help("...or once this many measurements have come in since it was last saved, if sooner")
+		.scan<'u', uint64_t>();
+	args.add_argument("--rollup")
+		.help("account the hosts of the fleet hierarchy in this JSON file, instead of input logs, and report each level of it");
+	args.add_argument("--jobs")
+		.help("...on this many threads")
+		.default_value(std::max(1u, std::thread::hardware_concurrency()))
+		.scan<'u', unsigned>();
+	args.add_argument("--memory-limit")
+		.help("keep the resident size within this many bytes (K, M, G suffixes), processing slower if need be");
+	args.add_argument("--approx")
+		.help("only read every this many blocks (of 1 MiB) of the inputs, and estimate the totals from them")
+		.scan<'u', unsigned>();
 
 	try {
 		args.parse_args(argc, argv);
@@ -188,93 +667,572 @@ int main(int argc, char **argv)
 		std::exit(1);
 	}
 
-	auto input_path = args.get<path>("input");
-	if (!exists(input_path)) {
-		throw std::runtime_error(
-			fmt::format(
-				"Input file {} does not exist",
-				input_path
-			));
+	auto input_paths = args.get<std::vector<path>>("input");
+	auto rollup_path = args.present("--rollup");
+	if (!input_paths.empty() + args.get<bool>("--hwmon") + bool(rollup_path) != 1) {
+		std::cerr << "Either input logs, --hwmon or --rollup must be given" << std::endl;
+		std::cerr << args << std::endl;
+		std::exit(1);
+	}
+	for (const auto &input_path: input_paths) {
+		if (!exists(input_path)) {
+			throw std::runtime_error(
+				fmt::format(
+					"Input file {} does not exist",
+					input_path
+				));
+		}
 	}
 
-	padded_string input_str = padded_string::load(input_path.native());
+	auto arrow_measurements_path = args.present("--arrow-measurements");
+	auto arrow_buckets_path = args.present("--arrow-buckets");
+	auto compact_path = args.present("--compact");
+	if ((arrow_measurements_path || arrow_buckets_path || compact_path) && (args.get<bool>("--follow") || args.get<bool>("--hwmon"))) {
+		std::cerr << "Arrow and compact export are not supported with --follow or --hwmon" << std::endl;
+		std::exit(1);
+	}
 
-	sj::parser parser;
-	sj::document_stream input_json = parser.iterate_many(input_str);
+	std::optional<TopQuery> top_query;
+	if (auto n = args.present<size_t>("--top")) {
+		auto by = args.get<std::string>("--top-by");
+		top_query = TopQuery{
+			.n = *n,
+			.by = by == "hour" ? TopQuery::HOUR : by == "session" ? TopQuery::SESSION : TopQuery::DAY,
+		};
+		if (by != "day" && by != "hour" && by != "session") {
+			std::cerr << "--top-by must be one of day, hour or session" << std::endl;
+			std::exit(1);
+		}
+		try {
+			if (auto since = args.present("--top-since")) {
+				top_query->since = parse_timestamp(*since);
+			}
+			if (auto until = args.present("--top-until")) {
+				top_query->until = parse_timestamp(*until);
+			}
+		} catch (const std::exception &) {
+			std::cerr << "--top-since and --top-until take timestamps like 2023-05-01T00:00:00+03:00" << std::endl;
+			std::exit(1);
+		}
+	}
 
-	bool is_first = true;
-	Measurement prev, m;
-	Result r{};
+	/* with a cache, measurements before the resume point are not seen again */
+	auto cache_dir = args.present("--cache");
+	if (cache_dir && (args.get<bool>("--follow") || args.get<bool>("--hwmon") || arrow_measurements_path || compact_path || args.present("--sqlite") || top_query)) {
+		std::cerr << "--cache is not supported with --follow, --hwmon, --arrow-measurements, --compact, --sqlite or --top" << std::endl;
+		std::exit(1);
+	}
 
-	for (sj::document_reference doc: input_json) try {
-		auto ts = parse_timestamp(doc.find_field("timestamp").get_string());
+	if (rollup_path && (args.get<bool>("--follow") || arrow_measurements_path || arrow_buckets_path || compact_path || args.present("--sqlite")
+			    || top_query || cache_dir || args.get<bool>("--cross-check") || args.present("--memory-limit"))) {
+		std::cerr << "--rollup is not supported with --follow, Arrow or compact export, --sqlite, --top, --cache, --cross-check or --memory-limit" << std::endl;
+		std::exit(1);
+	}
+	/* also catches NaN */
+	if (!(args.get<double>("--interval") > 0)) {
+		std::cerr << "--interval must be greater than 0" << std::endl;
+		std::exit(1);
+	}
+	if (args.get<unsigned>("--jobs") == 0) {
+		std::cerr << "--jobs must be at least 1" << std::endl;
+		std::exit(1);
+	}
 
-		sj::array device_items;
-		for (sj::object device: doc.find_field("data").get_array()) {
-			if (device.find_field("description").get_string() == "Corsair HX1000i"sv) {
-				device_items = device.find_field("status").get_array();
-				break;
+	auto approx = args.present<unsigned>("--approx");
+	if (approx && *approx == 0) {
+		std::cerr << "--approx must be at least 1" << std::endl;
+		std::exit(1);
+	}
+	if (approx && (args.get<bool>("--follow") || args.get<bool>("--hwmon") || rollup_path || arrow_measurements_path || arrow_buckets_path
+		       || compact_path || args.present("--sqlite") || top_query || cache_dir || args.get<bool>("--cross-check") || args.get<bool>("--load-states"))) {
+		std::cerr << "--approx is only supported with input logs, and not with Arrow or compact export, --sqlite, --top, --cache, --cross-check or --load-states" << std::endl;
+		std::exit(1);
+	}
+
+	auto state_path = args.present("--state");
+	if (args.present<uint64_t>("--state-records") == 0) {
+		std::cerr << "--state-records must be at least 1" << std::endl;
+		std::exit(1);
+	}
+	if (state_path && !args.get<bool>("--follow")) {
+		std::cerr << "--state is only supported with --follow" << std::endl;
+		std::exit(1);
+	}
+
+	/* with several inputs, head each report like tail(1) does */
+	auto print_header = [&](const path &input_path) {
+		if (input_paths.size() > 1) {
+			fmt::print("==> {} <==\n", input_path.native());
+		}
+	};
+
+	bool bad = false;
+	bool load_states = args.get<bool>("--load-states");
+
+	AlertRules rules{
+		.power_above = args.present<double>("--alert-power"),
+		.power_for = fp_seconds{args.get<double>("--alert-power-for")},
+		.daily_budget_kwh = args.present<double>("--alert-daily-kwh"),
+		.rollover = args.get<bool>("--alert-rollover"),
+		.exec = args.present("--alert-exec").value_or(""),
+		.fifo = args.present("--alert-fifo").value_or(""),
+	};
+
+	MemoryBudget budget;
+	if (auto limit = args.present("--memory-limit")) {
+		try {
+			budget = MemoryBudget::fit(parse_size(*limit));
+		} catch (const std::runtime_error &err) {
+			std::cerr << err.what() << std::endl;
+			std::exit(1);
+		}
+		if (cache_dir && budget.window < InputCache::BLOCK_SIZE) {
+			std::cerr << "--memory-limit is too low for --cache" << std::endl;
+			std::exit(1);
+		}
+		/* each followed log keeps a window of its own */
+		if (args.get<bool>("--follow")) {
+			try {
+				budget = budget.split(input_paths.size());
+			} catch (const std::runtime_error &err) {
+				std::cerr << err.what() << std::endl;
+				std::exit(1);
+			}
+		}
+	}
+
+	std::optional<SqliteSink> sqlite;
+	if (auto db = args.present("--sqlite")) {
+		sqlite.emplace(*db, fp_seconds{args.get<double>("--sqlite-series")});
+		if (budget.sqlite_cache) {
+			sqlite->set_cache_size(budget.sqlite_cache);
+		}
+	}
+
+	/* no SA_RESTART: the event loops have to wake up and return */
+	struct sigaction sa{};
+	sa.sa_handler = on_interrupt;
+
+	if (args.get<bool>("--hwmon")) {
+		HwmonCollector collector({
+			.sysfs = args.get<std::string>("--hwmon-sysfs"),
+			.power = args.get<std::string>("--hwmon-power"),
+			.interval = fp_seconds{args.get<double>("--interval")},
+		});
+
+		Accumulator acc;
+		Alerts alerts(rules, collector.path().native());
+		alerts.arm();
+		std::optional<SqliteSink::Source> recorded;
+		if (sqlite) {
+			recorded.emplace(*sqlite, collector.path().native(), acc.r);
+		}
+		std::optional<TopPeriods> top;
+		if (top_query) {
+			top.emplace(acc.r, *top_query);
+		}
+
+		sigaction(SIGINT, &sa, nullptr);
+		sigaction(SIGTERM, &sa, nullptr);
+
+		collector.run([&](const Measurement &m) {
+			acc.feed(m);
+			alerts.evaluate(acc.r, m);
+			if (recorded) {
+				recorded->feed(m);
 			}
+			if (top) {
+				top->feed(m);
+			}
+		}, interrupted);
+
+		if (sqlite) {
+			sqlite->checkpoint();
+		}
+		print_result(acc.r, load_states);
+		if (top) {
+			print_top(*top, *top_query);
 		}
+		return acc.r.bad ? 1 : 0;
+	}
+
+	if (args.get<bool>("--follow")) {
+		struct Followed
+		{
+			Accumulator acc;
+			Alerts alerts;
+			std::optional<SqliteSink::Source> recorded;
+			std::optional<TopPeriods> top;
+			LogFollower log;
+			uint64_t records = 0;
 
-		double uptime_cur, uptime_tot, pwr_input;
-		for (sj::object item: device_items) {
-			std::string_view key = item.find_field("key").get_string();
-			if (key == "Current uptime") {
-				uptime_cur = parse_item(item, "s");
-			} else if (key == "Total uptime") {
-				uptime_tot = parse_item(item, "s");
-			} else if (key == "Estimated input power") {
-				pwr_input = parse_item(item, "W");
+			Followed(const path &input_path, const AlertRules &rules, std::optional<SqliteSink> &sqlite,
+				 const std::optional<TopQuery> &top_query, const MemoryBudget &budget)
+				: alerts(rules, input_path.native())
+				, log(input_path, [this](const Measurement &m) {
+					++records;
+					acc.feed(m);
+					alerts.evaluate(acc.r, m);
+					if (recorded) {
+						recorded->feed(m);
+					}
+					if (top) {
+						top->feed(m);
+					}
+				}, budget)
+			{
+				if (sqlite) {
+					recorded.emplace(*sqlite, input_path.native(), acc.r);
+				}
+				if (top_query) {
+					top.emplace(acc.r, *top_query);
+				}
 			}
+
+			std::string save() const
+			{
+				StateWriter w;
+				put_state(w, acc);
+				put_anomalies(w, acc.r.anomalies);
+				alerts.save(w);
+				w.put<uint8_t>(recorded.has_value());
+				if (recorded) {
+					recorded->save(w);
+				}
+				w.put<uint8_t>(top.has_value());
+				if (top) {
+					top->save(w);
+				}
+				return std::move(w.out);
+			}
+
+			/* throws std::runtime_error if the state does not fit the options */
+			void restore(std::string_view state)
+			{
+				StateReader r{state};
+				Accumulator saved = get_state(r);
+				acc.r = saved.r;
+				acc.r.anomalies = get_anomalies(r);
+				acc.prev = saved.prev;
+				acc.is_first = saved.is_first;
+				alerts.restore(r);
+				if (r.get<uint8_t>() != recorded.has_value()) {
+					throw std::runtime_error("--sqlite has changed");
+				}
+				if (recorded) {
+					recorded->restore(r);
+				}
+				if (r.get<uint8_t>() != top.has_value()) {
+					throw std::runtime_error("--top has changed");
+				}
+				if (top) {
+					top->restore(r);
+				}
+				if (!r.in.empty()) {
+					throw std::runtime_error("trailing data");
+				}
+			}
+		};
+
+		std::optional<FollowSnapshot> snapshot;
+		if (state_path) {
+			snapshot.emplace(*state_path);
 		}
 
-		m = {
-			.stamp = ts,
-			.uptime_cur = uptime_cur,
-			.uptime_tot = uptime_tot,
-			.pwr = pwr_input,
+		FollowLoop loop;
+		std::vector<std::unique_ptr<Followed>> followed;
+		for (const auto &input_path: input_paths) {
+			followed.push_back(std::make_unique<Followed>(input_path, rules, sqlite, top_query, budget));
+			if (auto entry = snapshot ? snapshot->find(followed.back()->log) : std::nullopt) {
+				try {
+					followed.back()->restore(entry->state);
+					followed.back()->log.resume(entry->offset);
+					fmt::print(stderr, "{}: resuming from byte {}\n", input_path, entry->offset);
+				} catch (const std::runtime_error &err) {
+					fmt::print(stderr, "{}: not resuming from {} ({}), reading from the start\n",
+						   input_path, snapshot->path(), err.what());
+					followed.back() = std::make_unique<Followed>(input_path, rules, sqlite, top_query, budget);
+				}
+			}
+			loop.add(followed.back()->log);
+		}
+
+		/*
+		 * After the SQLite checkpoint, so that the database is never behind
+		 * the snapshot. Each save syncs, so saves are grouped by time or by
+		 * the number of measurements since the last one.
+		 */
+		auto state_interval = fp_seconds{args.get<double>("--state-interval")};
+		auto state_records = args.present<uint64_t>("--state-records");
+		std::optional<std::chrono::steady_clock::time_point> saved_at;
+		uint64_t saved_records = 0;
+		auto records = [&] {
+			uint64_t n = 0;
+			for (const auto &f: followed) {
+				n += f->records;
+			}
+			return n;
+		};
+		auto save_state = [&] {
+			if (sqlite) {
+				sqlite->sync_to_disk();
+			}
+			for (const auto &f: followed) {
+				snapshot->add(f->log, f->save());
+			}
+			snapshot->save();
+			saved_at = std::chrono::steady_clock::now();
+			saved_records = records();
 		};
 
-		if (is_first) {
-			is_first = false;
-		} else {
-			process_step(r, prev, m);
+		sigaction(SIGINT, &sa, nullptr);
+		sigaction(SIGTERM, &sa, nullptr);
+
+		loop.run([&] {
+			/* from now on, measurements are live */
+			for (auto &f: followed) {
+				f->alerts.arm();
+			}
+			if (sqlite) {
+				sqlite->checkpoint();
+			}
+			if (snapshot && (!saved_at || std::chrono::steady_clock::now() - *saved_at >= state_interval
+					 || (state_records && records() - saved_records >= *state_records))) {
+				save_state();
+			}
+		}, interrupted);
+
+		if (sqlite) {
+			sqlite->checkpoint();
+		}
+		if (snapshot) {
+			save_state();
+		}
+		for (const auto &f: followed) {
+			print_header(f->log.path());
+			print_result(f->acc.r, load_states);
+			if (f->top) {
+				print_top(*f->top, *top_query);
+			}
+			bad |= f->acc.r.bad;
 		}
+		return bad ? 1 : 0;
+	}
 
-		prev = m;
-	} catch (const simdjson::simdjson_error &e) {
-		fmt::print(stderr, "Failed to parse ({}):\n{}\n", e.what(), doc.raw_json().value());
+	/* rows are tagged with the input they come from */
+	std::vector<std::string> sources;
+	for (const auto &input_path: input_paths) {
+		sources.push_back(input_path.native());
+	}
+	std::optional<ArrowWriter> arrow_measurements, arrow_buckets;
+	if (arrow_measurements_path) {
+		arrow_measurements.emplace(*arrow_measurements_path, std::vector<ArrowColumn>{
+			{"source", ArrowType::DICTIONARY},
+			{"timestamp", ArrowType::TIMESTAMP},
+			{"uptime_cur_s", ArrowType::FLOAT64},
+			{"uptime_tot_s", ArrowType::FLOAT64},
+			{"power_w", ArrowType::FLOAT64},
+		}, sources, budget.arrow_rows);
+	}
+	if (arrow_buckets_path) {
+		arrow_buckets.emplace(*arrow_buckets_path, std::vector<ArrowColumn>{
+			{"source", ArrowType::DICTIONARY},
+			{"year", ArrowType::INT32},
+			{"month", ArrowType::INT32},
+			{"uptime_s", ArrowType::FLOAT64},
+			{"energy_j", ArrowType::FLOAT64},
+			{"energy_kwh", ArrowType::FLOAT64},
+			{"cost", ArrowType::FLOAT64},
+		}, sources, budget.arrow_rows);
+	}
+	std::optional<CompactWriter> compact;
+	if (compact_path) {
+		compact.emplace(*compact_path, sources);
 	}
 
-	fmt::print("Total rollover events: {}\n\n", r.rollovers);
-	fmt::print("-----------------------------------\n");
+	sj::parser parser;
+	size_t total_docs = 0, total_bytes = 0, cached_bytes = 0;
+	[[maybe_unused]] size_t loop_allocations = 0;
+	bool cross_check_failed = false;
+	auto start = std::chrono::steady_clock::now();
 
-	for (const auto &i: r.buckets) {
-		/* TODO: fmtlib does not yet support %j for durations
-		 *       (https://github.com/fmtlib/fmt/issues/3643) */
-		fmt::print(
-			"{:04d}-{:02d} uptime is {:2}d {:.1%Hh %Mm %Ss}\n",
-			std::get<0>(i.first),
-			std::get<1>(i.first),
-			std::chrono::floor<std::chrono::days>(i.second.time).count(),
-			i.second.time
-		);
-		fmt::print("        energy is {:>6.2f} kWh\n", i.second.energy_kwh());
-		fmt::print("           ... or {:>6.2f} ₽\n", i.second.energy_kwh() * i.second.COST_KWH);
+	if (rollup_path) {
+		Rollup rollup(*rollup_path);
+		std::atomic<size_t> docs = 0, bytes = 0;
+		rollup.run(args.get<unsigned>("--jobs"), [&](const path &log, sj::parser &parser) {
+			/* workers run concurrently, anomalies are printed by host afterwards */
+			Accumulator acc;
+			acc.quiet = true;
+			InputWindows input(log, budget.window);
+			Measurements measurements(input, parser, false, budget.batch_size);
+			for (const auto &m: measurements) {
+				acc.feed(m);
+			}
+			docs += measurements.docs();
+			bytes += file_size(log);
+			return acc.r;
+		});
+		total_docs = docs;
+		total_bytes = bytes;
+
+		static const char *const anomaly[] = {"Rollover", "Power loss", "Inconsistent measurement"};
+		for (const auto &node: rollup.nodes()) {
+			if (!node.children.empty() || node.r.anomalies.empty()) {
+				continue;
+			}
+			fmt::print("==> {}: anomalies <==\n", node.name);
+			for (const auto &a: node.r.anomalies) {
+				fmt::print("{} at {}\n", anomaly[a.kind], a.stamp);
+			}
+		}
+
+		for (const auto &node: rollup.nodes()) {
+			fmt::print("==> {} <==\n", node.name);
+			print_result(node.r, load_states);
+			bad |= node.r.bad;
+		}
 	}
 
-	fmt::print("----------------------------------\n");
+	for (int32_t source = 0; source < (int32_t)input_paths.size(); ++source) {
+		const path &input_path = input_paths[source];
 
-	/* TODO: fmtlib does not yet support %j for durations
-	 *       (https://github.com/fmtlib/fmt/issues/3643) */
-	fmt::print(
-		"Total uptime is {:3}d {:.1%Hh %Mm %Ss}\n",
-		std::chrono::floor<std::chrono::days>(r.total.time).count(),
-		r.total.time
-	);
-	fmt::print("Total energy is {:>8.2f} kWh\n", r.total.energy_kwh());
-	fmt::print("         ... or {:>8.2f} ₽\n", r.total.energy_kwh() * r.total.COST_KWH);
+		if (approx) {
+			ApproxResult r = approx_log(input_path, *approx, parser, budget);
+			total_docs += r.docs;
+			total_bytes += r.bytes;
+			print_header(input_path);
+			print_approx(r, *approx);
+			bad |= r.bad;
+			continue;
+		}
+
+		Accumulator acc;
+		std::optional<SqliteSink::Source> recorded;
+		if (sqlite) {
+			recorded.emplace(*sqlite, input_path.native(), acc.r);
+		}
+		std::optional<TopPeriods> top;
+		if (top_query) {
+			top.emplace(acc.r, *top_query);
+		}
+
+#ifdef LIQUIDCTL_ENERGY_COUNT_ALLOCATIONS
+		size_t allocations_before = allocation_count();
+#endif
+
+		auto feed = [&](sj::document_reference doc) {
+			Measurement m = parse_measurement(doc);
+			acc.feed(m);
+			if (arrow_measurements) {
+				arrow_measurements->append({source, m.stamp, m.uptime_cur, m.uptime_tot, m.pwr});
+			}
+			if (compact) {
+				compact->append(source, m);
+			}
+			if (recorded) {
+				recorded->feed(m);
+			}
+			if (top) {
+				top->feed(m);
+			}
+		};
+
+		/* with a cache, windows are its blocks */
+		std::optional<InputCache> cache;
+		if (cache_dir) {
+			cache.emplace(*cache_dir, input_path);
+		}
+		InputWindows input(input_path, cache ? InputCache::BLOCK_SIZE : budget.window);
+		auto window = input.next();
+		if (cache) {
+			for (; window.cut && cache->matches(window.data); window = input.next()) {
+				total_bytes += window.data.size();
+			}
+			cached_bytes += cache->restore(acc);
+		}
+		for (; !window.data.empty(); window = input.next()) {
+			total_bytes += window.data.size();
+			total_docs += for_each_document(parser, window.data, feed, false, budget.batch_size);
+			if (cache && window.cut) {
+				cache->seal(window.data, acc);
+			}
+		}
+		if (cache) {
+			cache->save();
+		}
+		if (sqlite) {
+			sqlite->checkpoint();
+		}
+
+#ifdef LIQUIDCTL_ENERGY_COUNT_ALLOCATIONS
+		loop_allocations += allocation_count() - allocations_before;
+#endif
+
+		if (args.get<bool>("--cross-check") && !cross_check(parser, input_path, budget, acc.r)) {
+			fmt::print(stderr, "Cross-check of {} failed\n", input_path);
+			cross_check_failed = true;
+		}
+
+		if (arrow_buckets) {
+			for (const auto &[key, bucket]: acc.r.buckets) {
+				arrow_buckets->append({
+					source,
+					std::get<0>(key),
+					std::get<1>(key),
+					bucket.time.count(),
+					bucket.energy_j,
+					bucket.energy_kwh(),
+					bucket.energy_kwh() * GroupResult::COST_KWH,
+				});
+			}
+		}
+
+		print_header(input_path);
+		print_result(acc.r, load_states);
+		if (top) {
+			print_top(*top, *top_query);
+		}
+		bad |= acc.r.bad;
+	}
 
-	return r.bad ? 1 : 0;
+	if (arrow_measurements) {
+		arrow_measurements->finish();
+	}
+	if (arrow_buckets) {
+		arrow_buckets->finish();
+	}
+	if (compact) {
+		compact->finish();
+	}
+
+	if (args.get<bool>("--stats")) {
+		/* includes loading the input and printing reports, as a user would see it */
+		fp_seconds elapsed = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr,
+			   "Processed {} documents ({:.1f} MB) in {:.3f} s: {:.1f} MB/s, {:.0f} ns/document\n",
+			   total_docs,
+			   total_bytes / 1e6,
+			   elapsed.count(),
+			   total_bytes / 1e6 / elapsed.count(),
+			   elapsed.count() * 1e9 / total_docs
+		);
+		if (cache_dir) {
+			fmt::print(stderr, "Skipped {:.1f} MB unchanged since the last run\n", cached_bytes / 1e6);
+		}
+		fmt::print(stderr, "Peak resident size: {:.1f} MB\n", peak_rss() / 1e6);
+		fmt::print(stderr, "Timestamp parsing: {}\n", timestamp_kernel());
+#ifdef LIQUIDCTL_ENERGY_COUNT_ALLOCATIONS
+		/* the parser's buffers and new buckets are allocated once, anything per-document is a regression */
+		fmt::print(stderr,
+			   "Heap allocations while processing documents: {} ({:.4f}/document)\n",
+			   loop_allocations,
+			   double(loop_allocations) / total_docs
+		);
+#endif
+	}
+
+	if (cross_check_failed) {
+		return 2;
+	}
+	return bad ? 1 : 0;
 }
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <utility>
+
+#include "energy.hpp"
+#include "input.hpp"
+
+/* where Measurements come from: windows of whole lines, padded for simdjson, empty at the end */
+template<typename S>
+concept ByteSource = requires(S &source) {
+	{ source.next().data } -> std::convertible_to<std::string_view>;
+};
+
+/* a log already in memory (padded for simdjson), as a single window */
+class PaddedBuffer
+{
+public:
+	explicit PaddedBuffer(std::string_view data) : data_(data) {}
+
+	InputWindows::Window next()
+	{
+		return {std::exchange(data_, {}), false};
+	}
+
+private:
+	std::string_view data_;
+};
+
+/*
+ * The measurements of a log, parsed as the range is iterated -- for
+ * consumers that want them rather than the accounting, e.g.
+ *
+ *	InputWindows input(path, window);
+ *	for (const auto &m: Measurements(input, parser) | std::views::filter(...))
+ *
+ * A single input range over `source`: windows are read as they are
+ * reached, and nothing is allocated per measurement. Broken documents are
+ * reported (unless `quiet`) and skipped, as by for_each_document().
+ *
+ * A view that can be moved but not copied: iterators point to its state,
+ * which stays where it is, so adaptors can take it over. An lvalue goes
+ * into them with std::move() (or as std::ranges::ref_view).
+ */
+template<ByteSource Source>
+class Measurements : public std::ranges::view_interface<Measurements<Source>>
+{
+	struct State;
+
+public:
+	using ParseTimestamp = ts_time (*)(std::string_view);
+
+	class iterator
+	{
+	public:
+		using value_type = Measurement;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+
+		const Measurement &operator*() const { return state_->current; }
+		const Measurement *operator->() const { return &state_->current; }
+
+		iterator &operator++()
+		{
+			state_->advance();
+			return *this;
+		}
+		void operator++(int) { ++*this; }
+
+		bool operator==(std::default_sentinel_t) const { return state_->done; }
+
+	private:
+		friend class Measurements;
+		explicit iterator(State *state) : state_(state) {}
+
+		State *state_ = nullptr;
+	};
+
+	Measurements(Source &source, sj::parser &parser, bool quiet = false,
+		     size_t batch_size = sj::DEFAULT_BATCH_SIZE, ParseTimestamp parse_ts = parse_timestamp_fast)
+		: state_(std::make_unique<State>(source, parser, quiet, batch_size, parse_ts))
+	{
+	}
+
+	Measurements(Measurements &&) = default;
+	Measurements &operator=(Measurements &&) = default;
+
+	/* once only, like any input range */
+	iterator begin()
+	{
+		state_->advance();
+		return iterator(state_.get());
+	}
+	std::default_sentinel_t end() const { return {}; }
+
+	/* documents so far, broken ones included */
+	size_t docs() const { return state_->docs + (state_->cursor ? state_->cursor->docs() : 0); }
+
+private:
+	struct State
+	{
+		State(Source &source, sj::parser &parser, bool quiet, size_t batch_size, ParseTimestamp parse_ts)
+			: source(source)
+			, parser(parser)
+			, quiet(quiet)
+			, batch_size(batch_size)
+			, parse_ts(parse_ts)
+		{
+		}
+
+		void advance()
+		{
+			auto parse = [this](sj::document_reference doc) {
+				current = parse_measurement(doc, parse_ts);
+			};
+			while (!cursor || !cursor->next(parse)) {
+				if (cursor) {
+					docs += cursor->docs();
+				}
+				std::string_view data = source.next().data;
+				if (data.empty()) {
+					cursor.reset();
+					done = true;
+					return;
+				}
+				cursor.emplace(parser, data, quiet, batch_size);
+			}
+		}
+
+		Source &source;
+		sj::parser &parser;
+		bool quiet;
+		size_t batch_size;
+		ParseTimestamp parse_ts;
+
+		std::optional<DocumentCursor> cursor;
+		size_t docs = 0;
+		Measurement current{};
+		bool done = false;
+	};
+
+	/* one allocation per range, for iterators to point to */
+	std::unique_ptr<State> state_;
+};
+
+static_assert(std::ranges::input_range<Measurements<InputWindows>>);
+static_assert(std::ranges::view<Measurements<InputWindows>>);
+static_assert(std::ranges::viewable_range<Measurements<InputWindows>>);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+/* calls fn(i) for each i < n, on up to `threads` threads; rethrows the first exception */
+template<typename F>
+void parallel_for(size_t n, unsigned threads, const F &fn)
+{
+	std::atomic<size_t> next = 0;
+	std::atomic<bool> failed = false;
+	std::exception_ptr error;
+
+	auto worker = [&] {
+		for (size_t i; !failed && (i = next++) < n; ) {
+			try {
+				fn(i);
+			} catch (...) {
+				if (!failed.exchange(true)) {
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	std::vector<std::jthread> pool;
+	for (unsigned t = 1; t < std::min<size_t>(threads, n); ++t) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	pool.clear();
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#include "energy.hpp"
+#include "input.hpp"
+#include "project.hpp"
+
+/* scalar tokens run up to the next structural character */
+static std::string_view trimmed(std::string_view s)
+{
+	return s.substr(0, s.find_last_not_of(" \t\r\n") + 1);
+}
+
+/* a raw JSON string in `names`, compared without its quotes */
+static bool selected(std::string_view raw, const std::vector<std::string> &names)
+{
+	if (raw.size() < 2 || raw.front() != '"') {
+		return false;
+	}
+	raw = raw.substr(1, raw.size() - 2);
+	return std::find(names.begin(), names.end(), raw) != names.end();
+}
+
+/* appends `item` to `out` if its key is selected */
+static void project_item(sj::object item, const Projection &p, std::string &out, bool &first)
+{
+	size_t mark = out.size();
+	out += first ? "{" : ",{";
+	bool keep = false, first_field = true;
+	for (sj::field field: item) {
+		std::string_view key = trimmed(field.key_raw_json_token());
+		std::string_view value = trimmed(field.value().raw_json());
+		if (field.key() == "key") {
+			keep = selected(value, p.keys);
+		}
+		if (!first_field) {
+			out += ',';
+		}
+		first_field = false;
+		out.append(key);
+		out += ':';
+		out.append(value);
+	}
+	if (!keep) {
+		out.resize(mark);
+		return;
+	}
+	out += '}';
+	first = false;
+}
+
+/* appends `device` to `out` if its description is selected */
+static void project_device(sj::object device, const Projection &p, std::string &out, std::string &status, bool &first)
+{
+	std::string_view description;
+	status.clear();
+	bool first_item = true, has_status = false;
+	for (sj::field field: device) {
+		if (field.key() == "description") {
+			description = trimmed(field.value().raw_json());
+		} else if (field.key() == "status") {
+			/* a status that is not an array throws, and the document is kept as it is */
+			for (sj::object item: field.value().get_array()) {
+				project_item(item, p, status, first_item);
+			}
+			has_status = true;
+		}
+	}
+	if (!selected(description, p.devices)) {
+		return;
+	}
+	/* the accounting takes a device without one as broken, not as one without status items */
+	if (!has_status) {
+		throw simdjson::simdjson_error(simdjson::NO_SUCH_FIELD);
+	}
+
+	if (!first) {
+		out += ',';
+	}
+	first = false;
+	out += "{\"description\":";
+	out.append(description);
+	out += ",\"status\":[";
+	out.append(status);
+	out += "]}";
+}
+
+void project_log(const std::filesystem::path &log, const Projection &p, std::FILE *out, ProjectStats &stats, const MemoryBudget &budget)
+{
+	sj::parser parser;
+	InputWindows input(log, budget.window);
+	std::string buf, data, status;
+
+	for (auto w = input.next(); !w.data.empty(); w = input.next()) {
+		buf.clear();
+
+		auto feed = [&](sj::document_reference doc) {
+			std::string_view stamp;
+			bool first = true, has_data = false;
+			data.clear();
+			for (sj::field field: doc.get_object()) {
+				if (field.key() == "timestamp") {
+					stamp = trimmed(field.value().raw_json());
+				} else if (field.key() == "data") {
+					for (sj::object device: field.value().get_array()) {
+						project_device(device, p, data, status, first);
+					}
+					has_data = true;
+				}
+			}
+			/* what the accounting takes as broken is kept as it is, below */
+			if (stamp.empty() || !has_data) {
+				throw simdjson::simdjson_error(simdjson::NO_SUCH_FIELD);
+			}
+
+			buf += "{\"timestamp\":";
+			buf.append(stamp);
+			buf += ",\"data\":[";
+			buf.append(data);
+			buf += "]}\n";
+		};
+
+		DocumentCursor cursor(parser, w.data, true, budget.batch_size);
+		cursor.on_broken([&](const char *, std::string_view raw) {
+			++stats.broken;
+			buf.append(raw);
+			buf += '\n';
+		});
+		while (cursor.next(feed)) {
+		}
+
+		stats.docs += cursor.docs();
+		stats.bytes_in += w.data.size();
+		stats.bytes_out += buf.size();
+		if (std::fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+			throw std::system_error(errno, std::generic_category(), "Failed to write out documents");
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "budget.hpp"
+
+/*
+ * Logs cut down to what is read of them, for keeping raw logs in less
+ * space: each document keeps its timestamp and, of the devices with one
+ * of `devices` as their description, the status items with one of `keys`
+ * -- in the same shape, without whitespace. Names are compared as they
+ * are written in the logs, escapes and all.
+ *
+ * Kept values are copied as they are, so a projected log accounts
+ * exactly like the original. Broken documents, those without a timestamp
+ * or data, and those with a kept device without a status array, are
+ * copied as they are too, for later processing to report them as before.
+ */
+struct Projection
+{
+	std::vector<std::string> devices, keys;
+};
+
+struct ProjectStats
+{
+	uint64_t docs = 0, broken = 0;
+	uint64_t bytes_in = 0, bytes_out = 0;
+};
+
+/* writes the projected documents of `log` to `out`, a line each */
+void project_log(const std::filesystem::path &log, const Projection &p, std::FILE *out, ProjectStats &stats, const MemoryBudget &budget = {});
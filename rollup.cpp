@@ -0,0 +1,93 @@
+#include <stdexcept>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "parallel.hpp"
+#include "rollup.hpp"
+
+namespace fs = std::filesystem;
+
+/* top-level entries have no parent */
+static const constexpr size_t NO_PARENT = SIZE_MAX;
+
+Rollup::Rollup(const fs::path &config)
+	: config_(config)
+{
+	auto json = simdjson::padded_string::load(config.native());
+	if (json.error()) {
+		throw std::runtime_error(fmt::format("Failed to read {}: {}", config, simdjson::error_message(json.error())));
+	}
+
+	try {
+		sj::parser parser;
+		sj::document doc = parser.iterate(json.value());
+		parse(doc.get_object(), "", 0, NO_PARENT);
+	} catch (const simdjson::simdjson_error &e) {
+		throw std::runtime_error(fmt::format("Failed to parse {}: {}", config, e.what()));
+	}
+	if (nodes_.empty()) {
+		throw std::runtime_error(fmt::format("{} has no hosts", config));
+	}
+}
+
+void Rollup::parse(sj::object obj, const std::string &prefix, size_t depth, size_t parent)
+{
+	depth_ = std::max(depth_, depth);
+
+	for (auto field: obj) {
+		std::string name = prefix + std::string(field.unescaped_key().value());
+		size_t index = nodes_.size();
+		nodes_.push_back({name, depth, {}, {}, {}});
+		if (parent != NO_PARENT) {
+			nodes_[parent].children.push_back(index);
+		}
+
+		sj::value value = field.value();
+		if (value.type() == sj::json_type::object) {
+			parse(value.get_object(), name + "/", depth + 1, index);
+		} else if (value.type() == sj::json_type::array) {
+			for (auto log: value.get_array()) {
+				/* operator/ keeps absolute paths as they are */
+				nodes_[index].logs.push_back(config_.parent_path() / std::string_view(log.get_string()));
+			}
+			if (nodes_[index].logs.empty()) {
+				throw std::runtime_error(fmt::format("{}: host {} has no logs", config_, name));
+			}
+		} else {
+			throw std::runtime_error(fmt::format("{}: {} is neither a level nor a host", config_, name));
+		}
+	}
+}
+
+void Rollup::run(unsigned threads, const Account &account)
+{
+	std::vector<size_t> hosts;
+	std::vector<std::vector<size_t>> levels(depth_ + 1);
+	for (size_t i = 0; i < nodes_.size(); ++i) {
+		if (nodes_[i].children.empty()) {
+			hosts.push_back(i);
+		} else {
+			levels[nodes_[i].depth].push_back(i);
+		}
+	}
+
+	/* a parser each, reused for all logs the thread gets to */
+	parallel_for(hosts.size(), threads, [&](size_t i) {
+		thread_local sj::parser parser;
+		Node &host = nodes_[hosts[i]];
+		for (const auto &log: host.logs) {
+			merge(host.r, account(log, parser));
+		}
+	});
+
+	/* bottom-up: the children of a level are all in the levels below it */
+	for (size_t depth = levels.size(); depth--; ) {
+		parallel_for(levels[depth].size(), threads, [&](size_t i) {
+			Node &node = nodes_[levels[depth][i]];
+			for (size_t child: node.children) {
+				merge(node.r, nodes_[child].r);
+			}
+		});
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "energy.hpp"
+
+/*
+ * Rollups of a fleet along its physical hierarchy (e.g. site, room, rack,
+ * host), read from a JSON file of nested objects with the logs of each
+ * host in an array as the leaves:
+ *
+ *	{"site-a": {"room-1": {"rack-1": {"host-1": ["host-1.jsonl"], ...}}}}
+ *
+ * Levels may be as deep as need be, and differ between branches. Relative
+ * log paths are relative to the file.
+ *
+ * Hosts are accounted in parallel, each log separately and merged into
+ * the host's result. Then each level is merged from the one below it, all
+ * nodes of a level in parallel.
+ */
+class Rollup
+{
+public:
+	struct Node
+	{
+		/* names from the top, joined by '/' */
+		std::string name;
+		size_t depth;
+		/* for hosts */
+		std::vector<std::filesystem::path> logs;
+		/* indices into nodes() */
+		std::vector<size_t> children;
+		Result r;
+	};
+
+	/* accounts a log, on any of the worker threads with the parser of that thread */
+	using Account = std::function<Result(const std::filesystem::path &log, sj::parser &parser)>;
+
+	explicit Rollup(const std::filesystem::path &config);
+
+	void run(unsigned threads, const Account &account);
+
+	/* parents before their children */
+	const std::vector<Node> &nodes() const { return nodes_; }
+
+private:
+	void parse(sj::object obj, const std::string &prefix, size_t depth, size_t parent);
+
+	std::filesystem::path config_;
+	std::vector<Node> nodes_;
+	size_t depth_ = 0;
+};
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "hash.hpp"
+#include "snapshot.hpp"
+#include "state.hpp"
+
+namespace fs = std::filesystem;
+
+static const char MAGIC[8] = {'L', 'C', 'E', 'S', 'T', 'A', 'T', 'E'};
+/* bump whenever the format or the accounting changes */
+static const uint32_t VERSION = 3;
+
+/* slot records are a sector apart, so that a torn write only ever takes one of them */
+static const constexpr uint64_t SECTOR = 512;
+static const constexpr int SLOTS = 2;
+/* bodies start past the header, page aligned */
+static const constexpr uint64_t HEADER = 4096;
+
+struct SlotRecord
+{
+	uint64_t seq;
+	uint64_t offset, size;
+	uint64_t checksum;
+};
+
+static std::string put_record(const SlotRecord &rec)
+{
+	StateWriter w;
+	w.out.append(MAGIC, sizeof(MAGIC));
+	w.put<uint32_t>(VERSION);
+	w.put<uint64_t>(rec.seq);
+	w.put<uint64_t>(rec.offset);
+	w.put<uint64_t>(rec.size);
+	w.put<uint64_t>(rec.checksum);
+	w.put<uint64_t>(xxh64(w.out));
+	return std::move(w.out);
+}
+
+/* a valid record, whose body is within `data` and checks out */
+static std::optional<SlotRecord> get_record(std::string_view data, int slot)
+{
+	try {
+		StateReader r{data.substr(std::min<size_t>(slot * SECTOR, data.size()))};
+		std::string_view fields = r.in.substr(0, sizeof(MAGIC) + sizeof(uint32_t) + 4 * sizeof(uint64_t));
+		if (r.take(sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC)) || r.get<uint32_t>() != VERSION) {
+			return std::nullopt;
+		}
+		SlotRecord rec;
+		rec.seq = r.get<uint64_t>();
+		rec.offset = r.get<uint64_t>();
+		rec.size = r.get<uint64_t>();
+		rec.checksum = r.get<uint64_t>();
+		if (r.get<uint64_t>() != xxh64(fields)
+		    || rec.offset < HEADER || rec.offset > data.size() || rec.size > data.size() - rec.offset
+		    || xxh64(data.substr(rec.offset, rec.size)) != rec.checksum) {
+			return std::nullopt;
+		}
+		return rec;
+	} catch (const std::runtime_error &) {
+		return std::nullopt;
+	}
+}
+
+/* bytes before the offset that have to be unchanged for a log to be resumed */
+static const constexpr size_t TAIL = 4096;
+
+/* hash of the bytes of `log` just before `offset` */
+static uint64_t tail_hash(const LogFollower &log, off_t offset)
+{
+	char buf[TAIL];
+	size_t len = std::min<off_t>(offset, TAIL);
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = pread(log.fd(), buf + done, len - done, offset - len + done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to read {}", log.path()));
+		}
+		if (n == 0) {
+			break;
+		}
+		done += n;
+	}
+	return xxh64({buf, done});
+}
+
+FollowSnapshot::FollowSnapshot(fs::path path)
+	: path_(std::move(path))
+	, zone_(local_zone()->name())
+{
+	int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			return;
+		}
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", path_));
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), fmt::format("Failed to stat {}", path_));
+	}
+	if (st.st_size > 0) {
+		void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			map_ = map;
+			map_size_ = st.st_size;
+		}
+	}
+	close(fd);
+
+	if (map_ && !load({static_cast<const char *>(map_), map_size_})) {
+		saved_.clear();
+	}
+}
+
+FollowSnapshot::~FollowSnapshot()
+{
+	if (map_) {
+		munmap(map_, map_size_);
+	}
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+}
+
+bool FollowSnapshot::load(std::string_view data)
+{
+	/* the newest slot that checks out; anything off just means starting over */
+	std::optional<SlotRecord> newest;
+	for (int slot = 0; slot < SLOTS; ++slot) {
+		auto rec = get_record(data, slot);
+		if (rec && (!newest || rec->seq > newest->seq)) {
+			newest = rec;
+			slot_ = slot;
+		}
+	}
+	if (!newest) {
+		return false;
+	}
+	/* the next save() goes into the other slot, and must not overwrite this body */
+	seq_ = newest->seq;
+	body_begin_ = newest->offset;
+	body_end_ = newest->offset + newest->size;
+
+	try {
+		StateReader r{data.substr(newest->offset, newest->size)};
+		if (r.get_string() != zone_) {
+			return false;
+		}
+
+		for (auto n = r.get<uint64_t>(); n; --n) {
+			Saved s;
+			s.log = r.get_string();
+			s.dev = r.get<uint64_t>();
+			s.ino = r.get<uint64_t>();
+			s.offset = r.get<uint64_t>();
+			s.tail = r.get<uint64_t>();
+			s.state = r.get_string();
+			saved_.push_back(std::move(s));
+		}
+		return r.in.empty();
+	} catch (const std::runtime_error &) {
+		return false;
+	}
+}
+
+std::optional<FollowSnapshot::Entry> FollowSnapshot::find(const LogFollower &log) const
+{
+	auto name = fs::weakly_canonical(log.path()).native();
+	for (const auto &s: saved_) {
+		if (s.log != name) {
+			continue;
+		}
+		struct stat st;
+		if (fstat(log.fd(), &st) < 0) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to stat {}", log.path()));
+		}
+		if (st.st_dev != s.dev || st.st_ino != s.ino || uint64_t(st.st_size) < s.offset
+		    || tail_hash(log, s.offset) != s.tail) {
+			return std::nullopt;
+		}
+		return Entry{off_t(s.offset), s.state};
+	}
+	return std::nullopt;
+}
+
+void FollowSnapshot::add(const LogFollower &log, std::string state)
+{
+	struct stat st;
+	if (fstat(log.fd(), &st) < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to stat {}", log.path()));
+	}
+	added_.push_back({
+		.log = fs::weakly_canonical(log.path()).native(),
+		.dev = st.st_dev,
+		.ino = st.st_ino,
+		.offset = uint64_t(log.offset()),
+		.tail = tail_hash(log, log.offset()),
+		.state = std::move(state),
+	});
+}
+
+void FollowSnapshot::write(std::string_view data, uint64_t offset)
+{
+	for (size_t done = 0; done < data.size(); ) {
+		ssize_t n = pwrite(fd_, data.data() + done, data.size() - done, offset + done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to write {}", path_));
+		}
+		done += n;
+	}
+}
+
+void FollowSnapshot::sync()
+{
+	if (fdatasync(fd_) < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to sync {}", path_));
+	}
+}
+
+void FollowSnapshot::save()
+{
+	if (fd_ < 0) {
+		bool created = !exists(path_);
+		fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+		if (fd_ < 0) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", path_));
+		}
+		/* a new file is not there after a power loss until its directory entry is synced */
+		if (created) {
+			fs::path dir = path_.parent_path().empty() ? "." : path_.parent_path();
+			int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dir_fd < 0 || fsync(dir_fd) < 0) {
+				int err = errno;
+				if (dir_fd >= 0) {
+					close(dir_fd);
+				}
+				throw std::system_error(err, std::generic_category(), fmt::format("Failed to sync {}", dir));
+			}
+			close(dir_fd);
+		}
+	}
+
+	StateWriter w;
+	w.put_string(zone_);
+	w.put<uint64_t>(added_.size());
+	for (const auto &a: added_) {
+		w.put_string(a.log);
+		w.put<uint64_t>(a.dev);
+		w.put<uint64_t>(a.ino);
+		w.put<uint64_t>(a.offset);
+		w.put<uint64_t>(a.tail);
+		w.put_string(a.state);
+	}
+	added_.clear();
+
+	/* before the current body if it fits there, after it otherwise */
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t offset = HEADER;
+	if (slot_ >= 0 && HEADER + w.out.size() > body_begin_) {
+		offset = (body_end_ + page - 1) / page * page;
+	}
+	SlotRecord rec{
+		.seq = seq_ + 1,
+		.offset = offset,
+		.size = w.out.size(),
+		.checksum = xxh64(w.out),
+	};
+	int slot = slot_ >= 0 ? 1 - slot_ : 0;
+
+	/* the body has to be on disk before a record points at it */
+	write(w.out, rec.offset);
+	sync();
+	write(put_record(rec), slot * SECTOR);
+	sync();
+
+	/* whatever is past both bodies is left over from earlier saves */
+	uint64_t end = std::max(rec.offset + rec.size, slot_ >= 0 ? body_end_ : 0);
+	if (ftruncate(fd_, end) < 0) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to truncate {}", path_));
+	}
+
+	slot_ = slot;
+	seq_ = rec.seq;
+	body_begin_ = rec.offset;
+	body_end_ = rec.offset + rec.size;
+}
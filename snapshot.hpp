@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "follow.hpp"
+
+/*
+ * Processing state of followed logs, saved now and then so that a
+ * restarted --follow goes on from where it was rather than reading the
+ * logs all over again.
+ *
+ * For each log, the file is identified by device and inode, and the
+ * bytes just before the offset are hashed: a log that has been replaced,
+ * truncated or rewritten since is read from the start, one that has only
+ * been appended to is read from the offset on. The state itself is
+ * opaque here.
+ *
+ * The file is double-buffered to survive power loss, the very thing that
+ * is being followed, without syncing it for every measurement: a header
+ * holds two checksummed slot records, in sectors of their own, each
+ * pointing at a body elsewhere in the file. save() writes the new body
+ * where it does not overlap the current one, syncs it, and only then
+ * writes the record into the other slot and syncs that. Whichever way a
+ * save is cut short, the newest valid slot is a consistent set of
+ * offsets and states.
+ *
+ * The file is mapped rather than read, and states are handed out as views
+ * into it, valid until the next save().
+ */
+class FollowSnapshot
+{
+public:
+	struct Entry
+	{
+		off_t offset;
+		std::string_view state;
+	};
+
+	/* a missing or unusable file is an empty snapshot */
+	explicit FollowSnapshot(std::filesystem::path path);
+	~FollowSnapshot();
+
+	FollowSnapshot(const FollowSnapshot &) = delete;
+	FollowSnapshot &operator=(const FollowSnapshot &) = delete;
+
+	/* the state of `log` at some offset, if the log still has the bytes up to it */
+	std::optional<Entry> find(const LogFollower &log) const;
+
+	/* records the state of `log` at its current offset, for the next save() */
+	void add(const LogFollower &log, std::string state);
+	/* durably replaces the saved states with the ones added since the last save() */
+	void save();
+
+	const std::filesystem::path &path() const { return path_; }
+
+private:
+	struct Saved
+	{
+		std::string log;
+		uint64_t dev, ino;
+		uint64_t offset;
+		uint64_t tail;
+		std::string_view state;
+	};
+	struct Added
+	{
+		std::string log;
+		uint64_t dev, ino;
+		uint64_t offset;
+		uint64_t tail;
+		std::string state;
+	};
+
+	bool load(std::string_view data);
+	void write(std::string_view data, uint64_t offset);
+	void sync();
+
+	std::filesystem::path path_;
+	std::string zone_;
+	void *map_ = nullptr;
+	size_t map_size_ = 0;
+	/* opened for writing by the first save() */
+	int fd_ = -1;
+
+	/* the newest valid slot, if any, and where its body is */
+	int slot_ = -1;
+	uint64_t seq_ = 0;
+	uint64_t body_begin_ = 0, body_end_ = 0;
+	std::vector<Saved> saved_;
+	std::vector<Added> added_;
+};
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <sqlite3.h>
+
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+#include "sqlite.hpp"
+#include "state.hpp"
+
+static const char SCHEMA[] = R"(
+CREATE TABLE IF NOT EXISTS buckets (
+	source TEXT NOT NULL,
+	year INTEGER NOT NULL,
+	month INTEGER NOT NULL,
+	uptime_s REAL NOT NULL,
+	energy_j REAL NOT NULL,
+	PRIMARY KEY (source, year, month)
+) WITHOUT ROWID;
+
+-- times are in seconds since the Unix epoch
+CREATE TABLE IF NOT EXISTS sessions (
+	source TEXT NOT NULL,
+	started REAL NOT NULL,
+	last_seen REAL NOT NULL,
+	energy_j REAL NOT NULL,
+	PRIMARY KEY (source, started)
+) WITHOUT ROWID;
+
+CREATE TABLE IF NOT EXISTS series (
+	source TEXT NOT NULL,
+	time REAL NOT NULL,
+	interval_s REAL NOT NULL,
+	power_avg_w REAL NOT NULL,
+	power_max_w REAL NOT NULL,
+	energy_j REAL NOT NULL,
+	PRIMARY KEY (source, time)
+) WITHOUT ROWID;
+)";
+
+static double unix_seconds(ts_time t)
+{
+	return fp_seconds{t.time_since_epoch()}.count();
+}
+
+SqliteSink::SqliteSink(const std::filesystem::path &db, fp_seconds series_interval, fp_seconds commit_interval)
+	: series_interval_(series_interval)
+	, commit_interval_(commit_interval)
+	, last_commit_(std::chrono::steady_clock::now())
+{
+	if (sqlite3_open_v2(db.c_str(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+		std::string err = db_ ? sqlite3_errmsg(db_) : "out of memory";
+		sqlite3_close(db_);
+		throw std::runtime_error(fmt::format("Failed to open {}: {}", db, err));
+	}
+
+	try {
+		exec("PRAGMA journal_mode = WAL");
+		/* still consistent after a crash, only the last transactions may be lost */
+		exec("PRAGMA synchronous = NORMAL");
+		exec(SCHEMA);
+
+		bucket_stmt_ = prepare(
+			"INSERT INTO buckets (source, year, month, uptime_s, energy_j) VALUES (?, ?, ?, ?, ?) "
+			"ON CONFLICT (source, year, month) DO UPDATE SET "
+			"uptime_s = excluded.uptime_s, energy_j = excluded.energy_j"
+		);
+		session_stmt_ = prepare(
+			"INSERT INTO sessions (source, started, last_seen, energy_j) VALUES (?, ?, ?, ?) "
+			"ON CONFLICT (source, started) DO UPDATE SET "
+			"last_seen = excluded.last_seen, energy_j = excluded.energy_j"
+		);
+		series_stmt_ = prepare(
+			"INSERT INTO series (source, time, interval_s, power_avg_w, power_max_w, energy_j) VALUES (?, ?, ?, ?, ?, ?) "
+			"ON CONFLICT (source, time) DO UPDATE SET "
+			"interval_s = excluded.interval_s, power_avg_w = excluded.power_avg_w, "
+			"power_max_w = excluded.power_max_w, energy_j = excluded.energy_j"
+		);
+	} catch (...) {
+		sqlite3_finalize(bucket_stmt_);
+		sqlite3_finalize(session_stmt_);
+		sqlite3_close(db_);
+		throw;
+	}
+}
+
+SqliteSink::~SqliteSink()
+{
+	sqlite3_finalize(bucket_stmt_);
+	sqlite3_finalize(session_stmt_);
+	sqlite3_finalize(series_stmt_);
+	/* an uncommitted transaction is rolled back */
+	sqlite3_close(db_);
+}
+
+void SqliteSink::exec(const char *sql)
+{
+	char *err = nullptr;
+	if (sqlite3_exec(db_, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+		std::string msg = err ? err : sqlite3_errmsg(db_);
+		sqlite3_free(err);
+		throw std::runtime_error(fmt::format("SQLite error: {}", msg));
+	}
+}
+
+sqlite3_stmt *SqliteSink::prepare(const char *sql)
+{
+	sqlite3_stmt *stmt = nullptr;
+	if (sqlite3_prepare_v3(db_, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+		throw std::runtime_error(fmt::format("SQLite error: {}", sqlite3_errmsg(db_)));
+	}
+	return stmt;
+}
+
+void SqliteSink::step(sqlite3_stmt *stmt)
+{
+	int rc = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	if (rc != SQLITE_DONE) {
+		throw std::runtime_error(fmt::format("SQLite error: {}", sqlite3_errmsg(db_)));
+	}
+}
+
+void SqliteSink::begin()
+{
+	if (!in_transaction_) {
+		exec("BEGIN");
+		in_transaction_ = true;
+	}
+}
+
+void SqliteSink::checkpoint()
+{
+	for (Source *s: sources_) {
+		s->sync();
+	}
+	if (in_transaction_) {
+		exec("COMMIT");
+		in_transaction_ = false;
+	}
+	last_commit_ = std::chrono::steady_clock::now();
+}
+
+void SqliteSink::sync_to_disk()
+{
+	/* syncs the WAL before copying it into the database, which is synced as well */
+	exec("PRAGMA wal_checkpoint(PASSIVE)");
+}
+
+void SqliteSink::set_cache_size(size_t bytes)
+{
+	/* negative for KiB rather than pages */
+	exec(fmt::format("PRAGMA cache_size = -{}", std::max<size_t>(bytes >> 10, 1)).c_str());
+}
+
+SqliteSink::Source::Source(SqliteSink &sink, std::string name, const Result &r)
+	: sink_(sink)
+	, name_(std::move(name))
+	, r_(r)
+{
+	sink_.sources_.push_back(this);
+}
+
+SqliteSink::Source::~Source()
+{
+	std::erase(sink_.sources_, this);
+}
+
+void SqliteSink::Source::feed(const Measurement &m)
+{
+	sink_.begin();
+
+	/* energy of the step that has led to `m` goes to the session and the interval that `m` is in */
+	if (!started_ || r_.rollovers != rollovers_) {
+		if (started_) {
+			write_session();
+		}
+		started_ = true;
+		rollovers_ = r_.rollovers;
+		session_begin_ = m.stamp - std::chrono::duration_cast<ts_time::duration>(fp_seconds{m.uptime_cur});
+		session_energy_ = energy_;
+	}
+	session_end_ = m.stamp;
+
+	if (sink_.series_interval_.count() > 0) {
+		/* timestamps may jitter backwards a little, do not reopen an interval that has been written out */
+		latest_ = std::max(latest_, m.stamp);
+		auto interval = (int64_t)std::floor(unix_seconds(latest_) / sink_.series_interval_.count());
+		if (power_count_ && interval != interval_) {
+			write_interval();
+			power_count_ = 0;
+		}
+		if (!power_count_) {
+			interval_ = interval;
+			interval_energy_ = energy_;
+			power_sum_ = 0;
+			power_max_ = m.pwr;
+		}
+		power_sum_ += m.pwr;
+		power_max_ = std::max(power_max_, m.pwr);
+		++power_count_;
+	}
+
+	energy_ = r_.total.energy_j;
+
+	if (std::chrono::steady_clock::now() - sink_.last_commit_ >= sink_.commit_interval_) {
+		sink_.checkpoint();
+	}
+}
+
+void SqliteSink::Source::sync()
+{
+	if (!started_) {
+		return;
+	}
+	sink_.begin();
+
+	sqlite3_stmt *stmt = sink_.bucket_stmt_;
+	for (const auto &[key, bucket]: r_.buckets) {
+		sqlite3_bind_text(stmt, 1, name_.data(), name_.size(), SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 2, std::get<0>(key));
+		sqlite3_bind_int(stmt, 3, std::get<1>(key));
+		sqlite3_bind_double(stmt, 4, bucket.time.count());
+		sqlite3_bind_double(stmt, 5, bucket.energy_j);
+		sink_.step(stmt);
+	}
+
+	write_session();
+	if (power_count_) {
+		write_interval();
+	}
+}
+
+void SqliteSink::Source::save(StateWriter &w) const
+{
+	w.put<uint8_t>(started_);
+	w.put<double>(energy_);
+	w.put<uint32_t>(rollovers_);
+	w.put<int64_t>(session_begin_.time_since_epoch().count());
+	w.put<int64_t>(session_end_.time_since_epoch().count());
+	w.put<double>(session_energy_);
+	w.put<int64_t>(latest_.time_since_epoch().count());
+	w.put<int64_t>(interval_);
+	w.put<double>(interval_energy_);
+	w.put<double>(power_sum_);
+	w.put<double>(power_max_);
+	w.put<uint64_t>(power_count_);
+}
+
+void SqliteSink::Source::restore(StateReader &r)
+{
+	auto get_time = [&] { return ts_time{ts_time::duration{r.get<int64_t>()}}; };
+	started_ = r.get<uint8_t>();
+	energy_ = r.get<double>();
+	rollovers_ = r.get<uint32_t>();
+	session_begin_ = get_time();
+	session_end_ = get_time();
+	session_energy_ = r.get<double>();
+	latest_ = get_time();
+	interval_ = r.get<int64_t>();
+	interval_energy_ = r.get<double>();
+	power_sum_ = r.get<double>();
+	power_max_ = r.get<double>();
+	power_count_ = r.get<uint64_t>();
+}
+
+void SqliteSink::Source::write_session()
+{
+	sqlite3_stmt *stmt = sink_.session_stmt_;
+	sqlite3_bind_text(stmt, 1, name_.data(), name_.size(), SQLITE_STATIC);
+	sqlite3_bind_double(stmt, 2, unix_seconds(session_begin_));
+	sqlite3_bind_double(stmt, 3, unix_seconds(session_end_));
+	sqlite3_bind_double(stmt, 4, energy_ - session_energy_);
+	sink_.step(stmt);
+}
+
+void SqliteSink::Source::write_interval()
+{
+	sqlite3_stmt *stmt = sink_.series_stmt_;
+	sqlite3_bind_text(stmt, 1, name_.data(), name_.size(), SQLITE_STATIC);
+	sqlite3_bind_double(stmt, 2, interval_ * sink_.series_interval_.count());
+	sqlite3_bind_double(stmt, 3, sink_.series_interval_.count());
+	sqlite3_bind_double(stmt, 4, power_sum_ / power_count_);
+	sqlite3_bind_double(stmt, 5, power_max_);
+	sqlite3_bind_double(stmt, 6, energy_ - interval_energy_);
+	sink_.step(stmt);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "energy.hpp"
+
+struct sqlite3;
+struct sqlite3_stmt;
+struct StateReader;
+struct StateWriter;
+
+/*
+ * Writes accounting results into an SQLite database:
+ *
+ *  - buckets: monthly totals, per source;
+ *  - sessions: spans between PSU power cycles, per source;
+ *  - series: power and energy downsampled to a fixed interval, if enabled.
+ *
+ * Rows are keyed so that writing them again replaces them, which makes
+ * repeated runs over the same log idempotent and lets follow mode update
+ * the rows that are still open in place.
+ *
+ * Writes are batched into transactions, which are committed by
+ * checkpoint() -- explicitly, or from Source::feed() once
+ * `commit_interval` has passed since the last one. The database is in
+ * WAL mode, so readers are not blocked meanwhile.
+ */
+class SqliteSink
+{
+public:
+	class Source;
+
+	SqliteSink(const std::filesystem::path &db, fp_seconds series_interval = {}, fp_seconds commit_interval = fp_seconds{1});
+	~SqliteSink();
+
+	SqliteSink(const SqliteSink &) = delete;
+	SqliteSink &operator=(const SqliteSink &) = delete;
+
+	/* writes the open rows of all sources and commits */
+	void checkpoint();
+	/* makes what has been committed survive power loss, which WAL mode only does at WAL checkpoints */
+	void sync_to_disk();
+
+	/* caps the page cache, which is 2 MB by default */
+	void set_cache_size(size_t bytes);
+
+private:
+	void exec(const char *sql);
+	sqlite3_stmt *prepare(const char *sql);
+	void step(sqlite3_stmt *stmt);
+	void begin();
+
+	sqlite3 *db_ = nullptr;
+	sqlite3_stmt *bucket_stmt_ = nullptr;
+	sqlite3_stmt *session_stmt_ = nullptr;
+	sqlite3_stmt *series_stmt_ = nullptr;
+	fp_seconds series_interval_, commit_interval_;
+	bool in_transaction_ = false;
+	std::chrono::steady_clock::time_point last_commit_;
+	std::vector<Source *> sources_;
+};
+
+/*
+ * One source of measurements (a log, a PSU), fed after the measurement
+ * has been fed into the accumulator that `r` belongs to.
+ */
+class SqliteSink::Source
+{
+public:
+	Source(SqliteSink &sink, std::string name, const Result &r);
+	~Source();
+
+	Source(const Source &) = delete;
+	Source &operator=(const Source &) = delete;
+
+	void feed(const Measurement &m);
+	/* writes the buckets and the open session and interval */
+	void sync();
+
+	/* the open session and interval, for FollowSnapshot */
+	void save(StateWriter &w) const;
+	void restore(StateReader &r);
+
+private:
+	void write_session();
+	void write_interval();
+
+	SqliteSink &sink_;
+	std::string name_;
+	const Result &r_;
+	bool started_ = false;
+	/* total energy after the last measurement */
+	double energy_ = 0;
+
+	unsigned rollovers_ = 0;
+	ts_time session_begin_{}, session_end_{};
+	double session_energy_ = 0;
+
+	ts_time latest_ = ts_time::min();
+	int64_t interval_ = 0;
+	double interval_energy_ = 0;
+	double power_sum_ = 0, power_max_ = 0;
+	size_t power_count_ = 0;
+};
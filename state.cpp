@@ -0,0 +1,91 @@
+#include "state.hpp"
+
+static void put_group(StateWriter &w, const GroupResult &g)
+{
+	w.put<double>(g.time.count());
+	w.put<double>(g.energy_j);
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		w.put<double>(g.load_time[s].count());
+		w.put<double>(g.load_energy_j[s]);
+	}
+}
+
+static void get_group(StateReader &r, GroupResult &g)
+{
+	g.time = fp_seconds{r.get<double>()};
+	g.energy_j = r.get<double>();
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		g.load_time[s] = fp_seconds{r.get<double>()};
+		g.load_energy_j[s] = r.get<double>();
+	}
+}
+
+void put_state(StateWriter &w, const Accumulator &acc)
+{
+	const Result &r = acc.r;
+	put_group(w, r.total);
+	w.put<uint32_t>(r.rollovers);
+	w.put<uint32_t>(r.power_losses);
+	w.put<uint8_t>(r.bad);
+	w.put<uint8_t>(acc.is_first);
+	w.put<int64_t>(acc.prev.stamp.time_since_epoch().count());
+	w.put<double>(acc.prev.uptime_cur);
+	w.put<double>(acc.prev.uptime_tot);
+	w.put<double>(acc.prev.pwr);
+	w.put<uint64_t>(r.buckets.size());
+	for (const auto &[key, bucket]: r.buckets) {
+		w.put<int32_t>(std::get<0>(key));
+		w.put<int32_t>(std::get<1>(key));
+		put_group(w, bucket);
+	}
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		w.put<double>(r.load.centroid[s]);
+		w.put<uint64_t>(r.load.count[s]);
+	}
+	w.put<uint8_t>(r.load.seen);
+}
+
+Accumulator get_state(StateReader &r)
+{
+	Accumulator acc;
+	get_group(r, acc.r.total);
+	acc.r.rollovers = r.get<uint32_t>();
+	acc.r.power_losses = r.get<uint32_t>();
+	acc.r.bad = r.get<uint8_t>();
+	acc.is_first = r.get<uint8_t>();
+	acc.prev.stamp = ts_time{ts_time::duration{r.get<int64_t>()}};
+	acc.prev.uptime_cur = r.get<double>();
+	acc.prev.uptime_tot = r.get<double>();
+	acc.prev.pwr = r.get<double>();
+	for (auto n = r.get<uint64_t>(); n; --n) {
+		int year = r.get<int32_t>();
+		int month = r.get<int32_t>();
+		get_group(r, acc.r.buckets[{year, month}]);
+	}
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		acc.r.load.centroid[s] = r.get<double>();
+		acc.r.load.count[s] = r.get<uint64_t>();
+	}
+	acc.r.load.seen = r.get<uint8_t>();
+	return acc;
+}
+
+void put_anomalies(StateWriter &w, const std::vector<Anomaly> &anomalies)
+{
+	w.put<uint64_t>(anomalies.size());
+	for (const auto &a: anomalies) {
+		w.put<uint8_t>(a.kind);
+		w.put<int64_t>(a.stamp.time_since_epoch().count());
+	}
+}
+
+std::vector<Anomaly> get_anomalies(StateReader &r)
+{
+	std::vector<Anomaly> anomalies;
+	for (auto n = r.get<uint64_t>(); n; --n) {
+		auto kind = Anomaly::Kind(r.get<uint8_t>());
+		auto stamp = ts_time{ts_time::duration{r.get<int64_t>()}};
+		anomalies.push_back({kind, stamp});
+	}
+	return anomalies;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "energy.hpp"
+
+/*
+ * Binary encoding of processing state, for the files that keep it
+ * between runs. Native byte order: they are not meant to be carried
+ * between machines.
+ */
+struct StateWriter
+{
+	std::string out;
+
+	template<typename T>
+	void put(T v)
+	{
+		out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+
+	void put_string(std::string_view s)
+	{
+		put<uint64_t>(s.size());
+		out.append(s);
+	}
+};
+
+/* throws std::runtime_error on truncated input */
+struct StateReader
+{
+	std::string_view in;
+
+	template<typename T>
+	T get()
+	{
+		T v;
+		std::memcpy(&v, take(sizeof(v)).data(), sizeof(v));
+		return v;
+	}
+
+	std::string_view get_string()
+	{
+		return take(get<uint64_t>());
+	}
+
+	std::string_view take(size_t n)
+	{
+		if (n > in.size()) {
+			throw std::runtime_error("truncated");
+		}
+		auto r = in.substr(0, n);
+		in.remove_prefix(n);
+		return r;
+	}
+};
+
+/* all of the accumulator but the anomalies, which may be kept apart */
+void put_state(StateWriter &w, const Accumulator &acc);
+Accumulator get_state(StateReader &r);
+
+void put_anomalies(StateWriter &w, const std::vector<Anomaly> &anomalies);
+std::vector<Anomaly> get_anomalies(StateReader &r);
@@ -0,0 +1,57 @@
+#include "alloc_count.hpp"
+#include "budget.hpp"
+#include "check.hpp"
+#include "energy.hpp"
+#include "input.hpp"
+
+/*
+ * The main loop over a log, as liquidctl_energy runs it, has to make no
+ * heap allocations per document once it is warmed up: the first window
+ * sizes the parser's buffers and opens the first bucket. What is left is
+ * what setting up the cursor over a window costs, the same for a single
+ * document as for a window full of them.
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+
+	MemoryBudget budget;
+	sj::parser parser;
+	Accumulator acc;
+	acc.quiet = true;
+
+	auto feed = [&](sj::document_reference doc) { acc.feed(parse_measurement(doc)); };
+
+	InputWindows input(argv[1], budget.window);
+	size_t windows = 0, docs = 0, setup = 0;
+	for (auto w = input.next(); !w.data.empty(); w = input.next(), ++windows) {
+		if (windows == 1) {
+			/* the first document again, on its own */
+			simdjson::padded_string first(w.data.substr(0, w.data.find('\n') + 1));
+			size_t before = allocation_count();
+			for_each_document(parser, first, [](sj::document_reference) {}, false, budget.batch_size);
+			setup = allocation_count() - before;
+		}
+
+		size_t before = allocation_count();
+		size_t n = for_each_document(parser, w.data, feed, false, budget.batch_size);
+		if (windows) {
+			/* each window on its own, so that one cannot make up for another */
+			auto extra = (ptrdiff_t)(allocation_count() - before) - (ptrdiff_t)setup;
+			if (extra) {
+				fmt::print(stderr, "window {}: {} heap allocations beyond setting up a cursor ({}), in {} documents\n",
+					   windows, extra, setup, n);
+			}
+			CHECK(extra == 0);
+			docs += n;
+		}
+	}
+
+	fmt::print("{} documents after the first window, {} heap allocations to set up a cursor over each\n", docs, setup);
+	CHECK(windows > 1);
+	CHECK(!acc.r.bad);
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+#include <cmath>
+
+#include "approx.hpp"
+#include "budget.hpp"
+#include "check.hpp"
+#include "energy.hpp"
+#include "input.hpp"
+#include "measurements.hpp"
+
+/*
+ * --approx with every block sampled has to come up with the exact totals,
+ * give or take nothing; with fewer blocks, with a margin
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+
+	Accumulator acc;
+	acc.quiet = true;
+	sj::parser parser;
+	{
+		InputWindows input(argv[1], MemoryBudget{}.window);
+		for (const auto &m: Measurements(input, parser, true)) {
+			acc.feed(m);
+		}
+	}
+	const Result &exact = acc.r;
+
+	/* the blocks add up in another order than the steps */
+	auto close = [](double a, double b) { return std::abs(a - b) <= 1e-9 * std::abs(b); };
+
+	ApproxResult all = approx_log(argv[1], 1, parser);
+	fmt::print("{} blocks: {} J, {} s; exactly {} J, {} s\n",
+		   all.blocks, all.energy_j.value, all.time_s.value, exact.total.energy_j, exact.total.time.count());
+	CHECK(all.blocks > 1 && all.sampled == all.blocks);
+	CHECK(close(all.energy_j.value, exact.total.energy_j) && all.energy_j.margin == 0);
+	CHECK(close(all.time_s.value, exact.total.time.count()) && all.time_s.margin == 0);
+	CHECK(all.bad == exact.bad);
+
+	ApproxResult some = approx_log(argv[1], 2, parser);
+	CHECK(some.blocks == all.blocks && some.sampled == (all.blocks + 1) / 2);
+	CHECK(some.energy_j.margin > 0 && some.time_s.margin > 0);
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fmt/std.h>
+
+#include "archive.hpp"
+#include "check.hpp"
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &p)
+{
+	std::ifstream f(p, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), {}};
+}
+
+/* what ArchiveReader::extract() writes */
+static std::string extract(const ArchiveReader &reader, const fs::path &out, ts_time since, ts_time until, unsigned threads,
+			   ArchiveReader::Scan &scan)
+{
+	std::FILE *f = std::fopen(out.c_str(), "wb");
+	if (!f) {
+		throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", out));
+	}
+	reader.extract(since, until, threads, f, scan);
+	std::fclose(f);
+	return read_file(out);
+}
+
+/*
+ * A log archived and extracted again, all of it and by spans of time,
+ * against its own lines
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+	std::string log = read_file(argv[1]);
+
+	/* each line along with its timestamp, by date::parse */
+	struct Line
+	{
+		std::string_view raw;
+		ts_time ts;
+	};
+	std::vector<Line> lines;
+	constexpr std::string_view prefix = "{\"timestamp\": \"";
+	for (size_t offset = 0; offset < log.size(); ) {
+		size_t eol = std::min(log.find('\n', offset), log.size());
+		std::string_view raw(log.data() + offset, std::min(eol + 1, log.size()) - offset);
+		offset = eol + 1;
+		if (!raw.starts_with(prefix)) {
+			fmt::print(stderr, "a line without a timestamp in the corpus: {}\n", raw);
+			return 1;
+		}
+		std::string_view stamp = raw.substr(prefix.size());
+		lines.push_back({raw, parse_timestamp(stamp.substr(0, stamp.find('"')))});
+	}
+	CHECK(lines.size() > 3);
+
+	TempDir tmp("lce-archive");
+	fs::path archive = tmp.path() / "liquidctl.jsonl.zst";
+	fs::path out = tmp.path() / "extracted.jsonl";
+	/* small frames for many of them, on both sides of a range */
+	auto frames = archive_log(argv[1], archive, 1, 256 << 10);
+	ArchiveReader reader(archive);
+	fmt::print("{} lines, {} frames\n", lines.size(), frames.size());
+	CHECK(reader.indexed());
+	CHECK(reader.frames().size() == frames.size() && frames.size() > 10);
+
+	for (unsigned threads: {1, 4}) {
+		ArchiveReader::Scan scan;
+		CHECK(extract(reader, out, ts_time::min(), ts_time::max(), threads, scan) == log);
+		CHECK(scan.whole == frames.size() && !scan.skipped && !scan.filtered);
+	}
+
+	ts_time third = lines[lines.size() / 3].ts, two_thirds = lines[2 * lines.size() / 3].ts;
+	struct Range
+	{
+		ts_time since, until;
+	};
+	for (auto [since, until]: {
+		Range{third, two_thirds},
+		Range{third, ts_time::max()},
+		Range{ts_time::min(), two_thirds},
+		Range{third, third},
+	}) {
+		std::string expected;
+		for (const auto &l: lines) {
+			if (l.ts >= since && l.ts < until) {
+				expected += l.raw;
+			}
+		}
+
+		ArchiveReader::Scan scan;
+		std::string extracted = extract(reader, out, since, until, 4, scan);
+		if (extracted != expected) {
+			fmt::print(stderr, "extracted {} bytes from {} to {}, expected {}\n",
+				   extracted.size(), since.time_since_epoch().count(), until.time_since_epoch().count(), expected.size());
+			++failed_checks;
+		}
+		CHECK(scan.skipped + scan.whole + scan.filtered == frames.size());
+		/* the edges of a span only decompress the frames they fall in */
+		CHECK(scan.filtered <= 2);
+		if (since != until) {
+			CHECK(scan.skipped > 0 && scan.whole > 0);
+		}
+	}
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+#include <map>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "energy.hpp"
+
+using namespace std::chrono;
+
+static bool equal(const GroupResult &a, const GroupResult &b)
+{
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		if (a.load_time[s] != b.load_time[s] || a.load_energy_j[s] != b.load_energy_j[s]) {
+			return false;
+		}
+	}
+	return a.time == b.time && a.energy_j == b.energy_j;
+}
+
+static bool equal(const Result &a, const Result &b)
+{
+	if (!equal(a.total, b.total) || a.buckets.size() != b.buckets.size()) {
+		return false;
+	}
+	for (auto ia = a.buckets.begin(), ib = b.buckets.begin(); ia != a.buckets.end(); ++ia, ++ib) {
+		if (ia->first != ib->first || !equal(ia->second, ib->second)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* the local month of `ts`, straight from the time zone */
+static GroupKey month_of(ts_time ts)
+{
+	auto local = local_days{floor<days>(ts.time_since_epoch() + local_zone()->get_info(ts).offset)};
+	year_month_day ymd{local};
+	return {(int)ymd.year(), (unsigned)ymd.month()};
+}
+
+/*
+ * Steps of up to `max_step` across [from, to), with the wall clock
+ * jittering back a little now and then.
+ */
+static std::vector<Measurement> series(sys_seconds from, sys_seconds to, double max_step, std::mt19937 &rng)
+{
+	std::uniform_real_distribution<double> step(0.1, max_step), pwr(40, 900);
+	std::bernoulli_distribution jitter(0.05);
+
+	std::vector<Measurement> ret;
+	Measurement m{.stamp = from, .uptime_cur = 3600, .uptime_tot = 1e6, .pwr = 150};
+	while (m.stamp < to) {
+		ret.push_back(m);
+		double dt = step(rng);
+		m.stamp += duration_cast<nanoseconds>(fp_seconds{dt});
+		m.uptime_cur += dt;
+		m.uptime_tot += dt;
+		m.pwr = pwr(rng);
+		if (jitter(rng)) {
+			ret.back().stamp += 1s;
+		}
+	}
+	return ret;
+}
+
+int main()
+{
+	/* run with TZ=Europe/Berlin */
+	CHECK(local_zone()->name() == "Europe/Berlin");
+
+	/* months begin at local midnight, CEST (+02:00) or CET (+01:00) */
+	CHECK(GroupKey::from_time(sys_days{2023y / March / 31} + 21h + 59min + 59s) == GroupKey(2023, 3));
+	CHECK(GroupKey::from_time(sys_days{2023y / March / 31} + 22h) == GroupKey(2023, 4));
+	CHECK(GroupKey::from_time(sys_days{2023y / December / 31} + 22h + 59min + 59s) == GroupKey(2023, 12));
+	CHECK(GroupKey::from_time(sys_days{2023y / December / 31} + 23h) == GroupKey(2024, 1));
+
+	/* each span is that of a single month and offset */
+	ts_time begin, end;
+	GroupKey::from_time(sys_days{2023y / March / 26}, begin, end);
+	CHECK(begin == sys_days{2023y / February / 28} + 23h && end == sys_days{2023y / March / 26} + 1h);
+	GroupKey::from_time(sys_days{2023y / March / 26} + 1h, begin, end);
+	CHECK(begin == sys_days{2023y / March / 26} + 1h && end == sys_days{2023y / March / 31} + 22h);
+
+	std::mt19937 rng(1);
+	struct Span
+	{
+		sys_seconds from, to;
+		double max_step;
+	};
+	const Span spans[] = {
+		/* CET to CEST, and the month after */
+		{sys_days{2023y / March / 25}, sys_days{2023y / April / 2}, 600},
+		/* CEST to CET, and the month after */
+		{sys_days{2023y / October / 28}, sys_days{2023y / November / 2}, 600},
+		/* the year after */
+		{sys_days{2023y / December / 31} + 20h, sys_days{2024y / January / 1} + 2h, 10},
+		/* steps longer than a month */
+		{sys_days{2023y / January / 1}, sys_days{2025y / January / 1}, 60 * 86400},
+	};
+	for (const auto &span: spans) {
+		auto ms = series(span.from, span.to, span.max_step, rng);
+
+		/* the account_step() span cache against a bucket lookup per step */
+		Accumulator cached, reference;
+		cached.quiet = reference.quiet = true;
+		reference.reference = true;
+		std::optional<Accumulator> copy;
+
+		std::map<GroupKey, fp_seconds> expected;
+		for (size_t i = 0; i < ms.size(); ++i) {
+			cached.feed(ms[i]);
+			reference.feed(ms[i]);
+			if (copy) {
+				copy->feed(ms[i]);
+			}
+			/* the cache does not carry over to copies */
+			if (i == ms.size() / 2) {
+				copy = cached;
+			}
+			if (i) {
+				expected[month_of(ms[i - 1].stamp)] += fp_seconds{ms[i].stamp - ms[i - 1].stamp};
+			}
+		}
+
+		CHECK(!cached.r.bad && cached.r.rollovers == 0);
+		CHECK(equal(cached.r, reference.r));
+		CHECK(copy && equal(cached.r, copy->r));
+
+		CHECK(cached.r.buckets.size() == expected.size());
+		for (const auto &[key, time]: expected) {
+			auto it = cached.r.buckets.find(key);
+			CHECK(it != cached.r.buckets.end() && it->second.time == time);
+		}
+	}
+
+	return failed_checks ? 1 : 0;
+}
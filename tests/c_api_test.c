@@ -0,0 +1,60 @@
+/* the C API, from C */
+#include <stdio.h>
+#include <string.h>
+
+#include "liquidctl_energy.h"
+
+static int failed_checks = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++failed_checks; \
+		} \
+	} while (0)
+
+#define LINE(ts, uptime, pwr) \
+	"{\"timestamp\": \"" ts "\", \"data\": [{\"bus\": \"hid\", \"address\": \"/dev/hidraw3\", " \
+	"\"description\": \"Corsair HX1000i\", \"status\": [" \
+	"{\"key\": \"Current uptime\", \"value\": " uptime ", \"unit\": \"s\"}, " \
+	"{\"key\": \"Total uptime\", \"value\": 1000" uptime ", \"unit\": \"s\"}, " \
+	"{\"key\": \"Estimated input power\", \"value\": " pwr ", \"unit\": \"W\"}]}]}\n"
+
+int main(void)
+{
+	lce_accumulator *acc = lce_create();
+	lce_totals totals;
+	size_t count;
+
+	/* a timestamp that does not parse in the middle of the first chunk, which ends within the last line */
+	const char *log =
+		LINE("2023-05-31T00:00:00,000000000+03:00", "100.0", "200.0")
+		LINE("2023-05-31T00:00:10,000000000+03:00", "110.0", "200.0")
+		LINE("2023-05-31T00:00:20,000000000+03:00", "120.0", "200.0")
+		LINE("yesterday", "125.0", "200.0")
+		LINE("2023-05-31T00:00:30,000000000+03:00", "130.0", "200.0")
+		LINE("2023-05-31T00:00:40,000000000+03:00", "140.0", "200.0");
+	size_t split = strlen(log) - 40;
+	CHECK(lce_feed_json_bytes(acc, log, split) == LCE_OK);
+	CHECK(lce_snapshot(acc, &totals, NULL, 0, &count) == LCE_ERROR_BUFFER_TOO_SMALL);
+	CHECK(totals.documents == 5 && totals.parse_errors == 1);
+	CHECK(totals.time_s == 30 && totals.energy_j == 30 * 200);
+	CHECK(count == 1);
+
+	/* the bad line is not fed again, and the last one is completed */
+	CHECK(lce_feed_json_bytes(acc, log + split, strlen(log) - split) == LCE_OK);
+	CHECK(lce_snapshot(acc, &totals, NULL, 0, &count) == LCE_ERROR_BUFFER_TOO_SMALL);
+	CHECK(totals.documents == 6 && totals.parse_errors == 1);
+	CHECK(totals.time_s == 40 && totals.energy_j == 40 * 200);
+
+	lce_bucket bucket;
+	CHECK(lce_snapshot(acc, &totals, &bucket, 1, &count) == LCE_OK);
+	CHECK(count == 1 && bucket.year == 2023 && bucket.month == 5 && bucket.time_s == 40);
+
+	CHECK(lce_feed_json_bytes(NULL, log, 1) == LCE_ERROR_INVALID_ARGUMENT);
+	CHECK(lce_feed_json_bytes(acc, NULL, 1) == LCE_ERROR_INVALID_ARGUMENT);
+
+	lce_destroy(acc);
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fmt/format.h>
+
+/*
+ * Assertions for the test programs: a failed one is reported along with
+ * where it is, and the program goes on. main() ends with
+ * `return failed_checks ? 1 : 0;` for ctest to see the test fail.
+ */
+inline int failed_checks = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fmt::print(stderr, "{}:{}: check failed: {}\n", __FILE__, __LINE__, #cond); \
+			++failed_checks; \
+		} \
+	} while (0)
+
+/* true if `fn` throws `E` */
+template<typename E, typename F>
+bool throws(F &&fn)
+{
+	try {
+		fn();
+	} catch (const E &) {
+		return true;
+	}
+	return false;
+}
+
+/* a fresh directory under the temporary directory, removed with everything in it when done */
+class TempDir
+{
+public:
+	explicit TempDir(std::string_view name)
+	{
+		std::string tmpl = (std::filesystem::temp_directory_path() / fmt::format("{}-XXXXXX", name)).native();
+		if (!mkdtemp(tmpl.data())) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to create {}", tmpl));
+		}
+		path_ = tmpl;
+	}
+	~TempDir() { std::filesystem::remove_all(path_); }
+
+	TempDir(const TempDir &) = delete;
+	TempDir &operator=(const TempDir &) = delete;
+
+	const std::filesystem::path &path() const { return path_; }
+
+private:
+	std::filesystem::path path_;
+};
@@ -0,0 +1,138 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "budget.hpp"
+#include "check.hpp"
+#include "compact.hpp"
+#include "energy.hpp"
+#include "input.hpp"
+#include "measurements.hpp"
+
+/* what a query has to come up with, a row at a time */
+static PowerSummary summarize(const std::vector<Measurement> &ms, ts_time since, ts_time until)
+{
+	PowerSummary s;
+	for (const auto &m: ms) {
+		if (m.stamp >= since && m.stamp < until) {
+			s.add(m);
+		}
+	}
+	return s;
+}
+
+/*
+ * Measurements written to a compact file in small blocks, and read back:
+ * all of them, and by queries over spans of time that skip blocks, take
+ * them from their zone maps and decode them
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+
+	std::vector<Measurement> ms;
+	Accumulator reference;
+	reference.quiet = true;
+	{
+		sj::parser parser;
+		InputWindows input(argv[1], MemoryBudget{}.window);
+		for (const auto &m: Measurements(input, parser, true)) {
+			ms.push_back(m);
+			reference.feed(m);
+		}
+	}
+	CHECK(ms.size() > 1000);
+
+	/* the second source has every third measurement, in blocks that do not line up with the first one's */
+	std::vector<Measurement> thirds;
+	for (size_t i = 0; i < ms.size(); i += 3) {
+		thirds.push_back(ms[i]);
+	}
+
+	TempDir tmp("lce-compact");
+	auto path = tmp.path() / "measurements.lce";
+	{
+		CompactWriter writer(path, {"a.jsonl", "b.jsonl"}, 64);
+		for (const auto &m: ms) {
+			writer.append(0, m);
+		}
+		for (const auto &m: thirds) {
+			writer.append(1, m);
+		}
+		writer.finish();
+	}
+	CompactReader reader(path);
+	CHECK(reader.sources() == (std::vector<std::string>{"a.jsonl", "b.jsonl"}));
+
+	/* the rows of the first source, accounted again */
+	{
+		Accumulator acc;
+		acc.quiet = true;
+		for (const auto &z: reader.zones()) {
+			if (z.source == 0) {
+				for (const auto &m: reader.decode(z)) {
+					acc.feed(m);
+				}
+			}
+		}
+		auto diffs = compare_results(reference.r, acc.r);
+		for (const auto &d: diffs) {
+			fmt::print(stderr, "decoded (reference vs. this): {}\n", d);
+		}
+		CHECK(diffs.empty());
+	}
+
+	/* in the middle of a block of either source, which are 64 and 3 * 64 measurements long */
+	auto mid_block = [&](size_t i) { return ms[i / 192 * 192 + 100].stamp; };
+	ts_time third = mid_block(ms.size() / 3), two_thirds = mid_block(2 * ms.size() / 3);
+	struct Range
+	{
+		ts_time since, until;
+	};
+	for (auto [since, until]: {
+		Range{ts_time::min(), ts_time::max()},
+		Range{third, two_thirds},
+		Range{third + std::chrono::nanoseconds{1}, two_thirds - std::chrono::nanoseconds{1}},
+		Range{third, third},
+		Range{ms.back().stamp + std::chrono::seconds{1}, ts_time::max()},
+	}) {
+		for (uint32_t source: {0u, 1u, CompactReader::SOURCES}) {
+			PowerSummary expected;
+			if (source != 1) {
+				expected = summarize(ms, since, until);
+			}
+			if (source != 0) {
+				PowerSummary b = summarize(thirds, since, until);
+				expected.samples += b.samples;
+				expected.first = std::min(expected.first, b.first);
+				expected.last = std::max(expected.last, b.last);
+				expected.min = std::min(expected.min, b.min);
+				expected.max = std::max(expected.max, b.max);
+				expected.sum += b.sum;
+			}
+
+			CompactReader::Scan scan;
+			PowerSummary s = reader.query(since, until, source, scan);
+			bool same = s.samples == expected.samples && s.first == expected.first && s.last == expected.last
+				&& s.min == expected.min && s.max == expected.max
+				/* summed in another order */
+				&& std::abs(s.sum - expected.sum) <= 1e-9 * std::abs(expected.sum);
+			if (!same) {
+				fmt::print(stderr, "source {}, from {} to {}: {} samples, sum {}; expected {} samples, sum {}\n",
+					   source, since.time_since_epoch().count(), until.time_since_epoch().count(),
+					   s.samples, s.sum, expected.samples, expected.sum);
+				++failed_checks;
+			}
+			CHECK(scan.skipped + scan.summarized + scan.decoded == reader.zones().size());
+
+			if (since == third && until == two_thirds) {
+				CHECK(scan.skipped > 0 && scan.summarized > 0 && scan.decoded > 0);
+			}
+		}
+	}
+
+	return failed_checks ? 1 : 0;
+}
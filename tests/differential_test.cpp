@@ -0,0 +1,224 @@
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "budget.hpp"
+#include "cache.hpp"
+#include "check.hpp"
+#include "energy.hpp"
+#include "follow.hpp"
+#include "input.hpp"
+#include "liquidctl_energy.h"
+#include "measurements.hpp"
+#include "snapshot.hpp"
+#include "state.hpp"
+
+namespace fs = std::filesystem;
+
+/* every optimised way through a log has to come up with the very Result of the straightforward one */
+static void compare(std::string_view what, const Result &reference, const Result &r)
+{
+	auto diffs = compare_results(reference, r);
+	for (const auto &d: diffs) {
+		fmt::print(stderr, "{} (reference vs. this): {}\n", what, d);
+	}
+	if (!diffs.empty()) {
+		++failed_checks;
+	}
+}
+
+/* the main loop of liquidctl_energy, with or without a --cache directory */
+static Result account(const fs::path &log, const MemoryBudget &budget, const fs::path *cache_dir = nullptr)
+{
+	sj::parser parser;
+	Accumulator acc;
+	acc.quiet = true;
+
+	std::optional<InputCache> cache;
+	if (cache_dir) {
+		cache.emplace(*cache_dir, log);
+	}
+	InputWindows input(log, cache ? InputCache::BLOCK_SIZE : budget.window);
+	auto window = input.next();
+	if (cache) {
+		for (; window.cut && cache->matches(window.data); window = input.next()) {
+		}
+		cache->restore(acc);
+	}
+	for (; !window.data.empty(); window = input.next()) {
+		for_each_document(parser, window.data, [&](sj::document_reference doc) {
+			acc.feed(parse_measurement(doc));
+		}, true, budget.batch_size);
+		if (cache && window.cut) {
+			cache->seal(window.data, acc);
+		}
+	}
+	if (cache) {
+		cache->save();
+	}
+	return acc.r;
+}
+
+static std::string read_file(const fs::path &p)
+{
+	std::ifstream f(p, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), {}};
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+	fs::path corpus = argv[1];
+	std::string log = read_file(corpus);
+	std::mt19937 rng(1);
+
+	/* date::parse for timestamps and a bucket lookup per step */
+	Accumulator reference;
+	reference.reference = true;
+	reference.quiet = true;
+	size_t docs, measurements = 0;
+	{
+		sj::parser parser;
+		InputWindows input(corpus, MemoryBudget{}.window);
+		Measurements ms(input, parser, true, MemoryBudget{}.batch_size, parse_timestamp);
+		for (const auto &m: ms) {
+			reference.feed(m);
+			++measurements;
+		}
+		docs = ms.docs();
+	}
+	const Result &expected = reference.r;
+	fmt::print("{} documents, {} measurements, {} anomalies, {} buckets\n",
+		   docs, measurements, expected.anomalies.size(), expected.buckets.size());
+	CHECK(docs > measurements);
+	CHECK(expected.buckets.size() > 1);
+
+	compare("default", expected, account(corpus, {}));
+
+	/* what --memory-limit comes down to: small windows, and batches down to a couple of lines */
+	for (size_t window: {64 << 10, 16 << 10, 4 << 10}) {
+		for (size_t batch_size: {16 << 10, 4 << 10, 1 << 10}) {
+			if (batch_size <= window) {
+				compare(fmt::format("window {}, batch size {}", window, batch_size), expected,
+					account(corpus, {.window = window, .batch_size = batch_size}));
+			}
+		}
+	}
+
+	TempDir tmp("lce-differential");
+	fs::path copy = tmp.path() / "liquidctl.jsonl";
+	fs::path cache_dir = tmp.path() / "cache";
+	fs::create_directories(cache_dir);
+
+	/* --cache: a run on part of the log, which is then appended to mid-line, and a run on it unchanged */
+	{
+		size_t cut = log.size() / 3 + 17;
+		std::ofstream(copy, std::ios::binary) << log.substr(0, cut);
+		account(copy, {}, &cache_dir);
+		std::ofstream(copy, std::ios::binary | std::ios::app) << log.substr(cut);
+		compare("--cache, appended", expected, account(copy, {}, &cache_dir));
+		compare("--cache, unchanged", expected, account(copy, {}, &cache_dir));
+	}
+
+	/* following the log, as it grows by chunks that split lines anywhere */
+	for (size_t window: {64 << 10, 4 << 10}) {
+		Accumulator acc;
+		acc.quiet = true;
+		sj::parser parser;
+		std::ofstream(copy, std::ios::binary | std::ios::trunc).flush();
+		LogFollower follower(copy, [&](const Measurement &m) { acc.feed(m); }, {.window = window, .batch_size = 1 << 10});
+
+		std::uniform_int_distribution<size_t> chunk(1, 3 * window);
+		for (size_t pos = 0; pos < log.size(); ) {
+			size_t n = std::min(chunk(rng), log.size() - pos);
+			std::ofstream(copy, std::ios::binary | std::ios::app) << log.substr(pos, n);
+			pos += n;
+			follower.drain(parser);
+		}
+		compare(fmt::format("followed, window {}", window), expected, acc.r);
+	}
+
+	/*
+	 * --state: following the log, with the process restarted from the
+	 * saved state every so often, as the log grows by chunks that split
+	 * lines anywhere
+	 */
+	{
+		fs::path state_path = tmp.path() / "state";
+		std::ofstream(copy, std::ios::binary | std::ios::trunc).flush();
+		std::uniform_int_distribution<size_t> chunk(1, log.size() / 5);
+		size_t resumed = 0;
+		Result r;
+		for (size_t pos = 0; pos < log.size(); ) {
+			Accumulator acc;
+			acc.quiet = true;
+			sj::parser parser;
+			LogFollower follower(copy, [&](const Measurement &m) { acc.feed(m); });
+			FollowSnapshot snapshot(state_path);
+			if (auto entry = snapshot.find(follower)) {
+				StateReader sr{entry->state};
+				Accumulator saved = get_state(sr);
+				acc.r = saved.r;
+				acc.r.anomalies = get_anomalies(sr);
+				acc.prev = saved.prev;
+				acc.is_first = saved.is_first;
+				follower.resume(entry->offset);
+				++resumed;
+			}
+
+			/* a couple of chunks a run */
+			for (int i = 0; i < 2 && pos < log.size(); ++i) {
+				size_t n = std::min(chunk(rng), log.size() - pos);
+				std::ofstream(copy, std::ios::binary | std::ios::app) << log.substr(pos, n);
+				pos += n;
+				follower.drain(parser);
+			}
+
+			StateWriter w;
+			put_state(w, acc);
+			put_anomalies(w, acc.r.anomalies);
+			snapshot.add(follower, std::move(w.out));
+			snapshot.save();
+			r = acc.r;
+		}
+		CHECK(resumed > 1);
+		compare(fmt::format("--state, resumed {} times", resumed), expected, r);
+	}
+
+	/* the C API, fed chunks that split lines anywhere */
+	for (size_t max_chunk: {1 << 20, 4 << 10, 64}) {
+		lce_accumulator *acc = lce_create();
+		std::uniform_int_distribution<size_t> chunk(1, max_chunk);
+		bool ok = true;
+		for (size_t pos = 0; pos < log.size(); ) {
+			size_t n = std::min(chunk(rng), log.size() - pos);
+			ok &= lce_feed_json_bytes(acc, log.data() + pos, n) == LCE_OK;
+			pos += n;
+		}
+		CHECK(ok);
+
+		lce_totals totals;
+		std::vector<lce_bucket> buckets(expected.buckets.size() + 1);
+		size_t count;
+		CHECK(lce_snapshot(acc, &totals, buckets.data(), buckets.size(), &count) == LCE_OK);
+		CHECK(totals.documents == docs && totals.parse_errors == docs - measurements);
+		CHECK(totals.time_s == expected.total.time.count() && totals.energy_j == expected.total.energy_j);
+		CHECK(totals.rollovers == expected.rollovers && totals.power_losses == expected.power_losses);
+		CHECK(!totals.bad == !expected.bad);
+		CHECK(count == expected.buckets.size());
+		auto it = expected.buckets.begin();
+		for (size_t i = 0; i < count && it != expected.buckets.end(); ++i, ++it) {
+			const auto &[key, bucket] = *it;
+			CHECK(buckets[i].year == std::get<0>(key) && (unsigned)buckets[i].month == std::get<1>(key));
+			CHECK(buckets[i].time_s == bucket.time.count() && buckets[i].energy_j == bucket.energy_j);
+		}
+		lce_destroy(acc);
+	}
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+#include <csignal>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "check.hpp"
+#include "hwmon.hpp"
+
+namespace fs = std::filesystem;
+
+/* a sysfs attribute, as the kernel would show it */
+static void write_attr(const fs::path &p, std::string_view value)
+{
+	fs::create_directories(p.parent_path());
+	std::ofstream(p) << value << '\n';
+}
+
+int main()
+{
+	TempDir tmp("lce-hwmon");
+	fs::path sysfs = tmp.path();
+	fs::path hwmon = sysfs / "class" / "hwmon" / "hwmon3";
+
+	/* another device first, which is to be passed over */
+	write_attr(sysfs / "class" / "hwmon" / "hwmon0" / "name", "nct6775");
+	write_attr(sysfs / "class" / "hwmon" / "hwmon0" / "power1_input", "1");
+	write_attr(hwmon / "name", "corsair-psu");
+	write_attr(hwmon / "power1_input", "123456789");
+	write_attr(hwmon / "power2_input", "5000000");
+
+	/* without debugfs, both uptimes are the time since the start */
+	{
+		HwmonCollector collector({.sysfs = sysfs});
+		CHECK(collector.path() == hwmon);
+
+		Measurement m = collector.sample();
+		CHECK(m.pwr == 123.456789);
+		CHECK(m.uptime_cur == m.uptime_tot);
+		CHECK(m.uptime_cur >= 0 && m.uptime_cur < 60);
+
+		/* re-read from the same descriptor */
+		write_attr(hwmon / "power1_input", "200000000");
+		CHECK(collector.sample().pwr == 200);
+	}
+
+	CHECK(HwmonCollector({.sysfs = sysfs, .power = "power2_input"}).sample().pwr == 5);
+
+	/* corsair-psu's debugfs directory is named after the HID device */
+	fs::path debugfs = sysfs / "kernel" / "debug" / "corsair-psu-0003:1B1C:1C05.0001";
+	write_attr(debugfs / "uptime", "3600");
+	write_attr(debugfs / "uptime_total", "1000000");
+	{
+		HwmonCollector collector({.sysfs = sysfs});
+		Measurement m = collector.sample();
+		CHECK(m.uptime_cur == 3600);
+		CHECK(m.uptime_tot == 1000000);
+
+		/* samples until stopped, at the interval */
+		std::vector<Measurement> samples;
+		volatile std::sig_atomic_t stop = 0;
+		HwmonCollector fast({.sysfs = sysfs, .interval = fp_seconds{0.01}});
+		fast.run([&](const Measurement &m) {
+			samples.push_back(m);
+			stop = samples.size() == 3;
+		}, stop);
+		CHECK(samples.size() == 3);
+		CHECK(samples.size() == 3 && samples[2].stamp - samples[0].stamp >= std::chrono::milliseconds{20});
+	}
+
+	CHECK(throws<std::runtime_error>([&] { HwmonCollector({.sysfs = sysfs, .name = "corsair-cpro"}); }));
+	CHECK(throws<std::system_error>([&] { HwmonCollector({.sysfs = sysfs, .power = "power9_input"}); }));
+	CHECK(throws<std::runtime_error>([&] { HwmonCollector({.sysfs = tmp.path() / "missing"}); }));
+
+	write_attr(hwmon / "power1_input", "garbage");
+	CHECK(throws<std::runtime_error>([&] { HwmonCollector({.sysfs = sysfs}).sample(); }));
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#include <cmath>
+#include <vector>
+
+#include "check.hpp"
+#include "energy.hpp"
+
+using namespace std::chrono;
+
+/* the idle, normal and peak parts of `g`, which have to add up to all of it */
+static bool adds_up(const GroupResult &g)
+{
+	fp_seconds time{};
+	double energy = 0;
+	for (int s = 0; s < LOAD_STATES; ++s) {
+		time += g.load_time[s];
+		energy += g.load_energy_j[s];
+	}
+	return std::abs((time - g.time).count()) <= 1e-9 * g.time.count() && std::abs(energy - g.energy_j) <= 1e-9 * g.energy_j;
+}
+
+/*
+ * --load-states on hours of normal, idle and peak load in turn, over the
+ * end of a month: each state gets about the hours it was in, and in the
+ * total and in each bucket, the states add up to all of it
+ */
+int main()
+{
+	static const double pwr[] = {200, 60, 200, 800};
+	const auto phase = hours{1};
+	const auto interval = seconds{10};
+
+	Accumulator acc;
+	acc.quiet = true;
+	ts_time start = parse_timestamp("2023-05-31T21:00:00+00:00");
+	double uptime = 3600;
+	for (int cycle = 0; cycle < 3; ++cycle) {
+		for (double p: pwr) {
+			for (auto t = interval; t <= phase; t += interval) {
+				acc.feed({start, uptime, 1e6 + uptime, p});
+				start += interval;
+				uptime += interval.count();
+			}
+		}
+	}
+	const Result &r = acc.r;
+
+	CHECK(r.buckets.size() == 2);
+	CHECK(adds_up(r.total));
+	for (const auto &[key, bucket]: r.buckets) {
+		CHECK(adds_up(bucket));
+	}
+
+	/* give or take the steps between two loads, which are of neither */
+	fp_seconds slack = 3 * 4 * interval;
+	CHECK(std::abs((r.total.load_time[IDLE] - 3 * phase).count()) <= slack.count());
+	CHECK(std::abs((r.total.load_time[NORMAL] - 6 * phase).count()) <= slack.count());
+	CHECK(std::abs((r.total.load_time[PEAK] - 3 * phase).count()) <= slack.count());
+	CHECK(std::abs(r.total.load_energy_j[PEAK] - 800 * fp_seconds(3 * phase).count()) <= 800 * slack.count());
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "../check.hpp"
+
+static std::string line(std::string_view ts)
+{
+	return fmt::format(
+		"{{\"timestamp\": \"{}\", \"data\": [{{\"description\": \"Corsair HX1000i\", \"status\": ["
+		"{{\"key\": \"Estimated input power\", \"value\": 200, \"unit\": \"W\"}}]}}]}}\n",
+		ts);
+}
+
+static ts_time at(int sec)
+{
+	return parse_timestamp(fmt::format("2023-05-31T00:{:02d}:{:02d},000000000+03:00", sec / 60, sec % 60));
+}
+
+int main()
+{
+	TempDir tmp("lce-check");
+	auto log_path = tmp.path() / "liquidctl.jsonl";
+
+	/* where each line starts */
+	std::vector<uint64_t> offsets;
+	std::string log;
+	auto add = [&](std::string_view l) {
+		offsets.push_back(log.size());
+		log += l;
+	};
+	for (int sec: {0, 10, 20}) {
+		add(line(fmt::format("2023-05-31T00:00:{:02d},000000000+03:00", sec)));
+	}
+	/* JSON all right, but not a timestamp */
+	add(line("yesterday"));
+	add(line("2023-05-31T00:00:30,000000000+03:00"));
+	/* not JSON */
+	add("{\"timestamp\": \"broken\n");
+	/* a step backwards, and a gap */
+	add(line("2023-05-31T00:00:25,000000000+03:00"));
+	add(line("2023-05-31T00:05:00,000000000+03:00"));
+	offsets.push_back(log.size());
+	std::ofstream(log_path, std::ios::binary) << log;
+
+	/* the whole log in a single batch, and a batch per line or so */
+	for (MemoryBudget budget: {MemoryBudget{}, MemoryBudget{.window = 1 << 10, .batch_size = 256}}) {
+		LogCheck c = check_log(log_path, fp_seconds{60}, budget);
+		CHECK(c.bytes == log.size());
+		CHECK(c.docs == 8);
+		CHECK(c.broken == 2);
+		CHECK(c.backwards == 1);
+		CHECK(!c.ok());
+
+		CHECK(c.corrupt.size() == 2);
+		if (c.corrupt.size() == 2) {
+			CHECK(c.corrupt[0].begin == offsets[3] && c.corrupt[0].end + 1 == offsets[4] && c.corrupt[0].docs == 1);
+			CHECK(c.corrupt[1].begin == offsets[5] && c.corrupt[1].end + 1 == offsets[6] && c.corrupt[1].docs == 1);
+		}
+
+		CHECK(c.gaps.size() == 1);
+		if (c.gaps.size() == 1) {
+			CHECK(c.gaps[0].from == at(25) && c.gaps[0].to == at(300));
+		}
+		CHECK(c.first == at(0) && c.last == at(300));
+		CHECK(c.min == at(0) && c.max == at(300));
+		/* documents that are broken do not count */
+		CHECK(c.devices.size() == 1 && c.devices.begin()->second == 6);
+	}
+
+	/* in UTC, whatever the local time zone */
+	LogCheck c = check_log(log_path, fp_seconds{60});
+	std::string json = check_json(log_path, c);
+	CHECK(json.find("\"first\": \"2023-05-30T21:00:00.000000000Z\"") != json.npos);
+	CHECK(json.find("\"gaps\": [{\"from\": \"2023-05-30T21:00:25.000000000Z\", \"to\": \"2023-05-30T21:05:00.000000000Z\", \"length_s\": 275}]") != json.npos);
+
+	return failed_checks ? 1 : 0;
+}
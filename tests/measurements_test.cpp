@@ -0,0 +1,68 @@
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "measurements.hpp"
+
+static std::string line(int sec, double pwr)
+{
+	return fmt::format(
+		"{{\"timestamp\": \"2023-05-31T00:00:{:02d},000000000+03:00\", "
+		"\"data\": [{{\"description\": \"Corsair HX1000i\", \"status\": ["
+		"{{\"key\": \"Current uptime\", \"value\": {}, \"unit\": \"s\"}}, "
+		"{{\"key\": \"Total uptime\", \"value\": {}, \"unit\": \"s\"}}, "
+		"{{\"key\": \"Estimated input power\", \"value\": {}, \"unit\": \"W\"}}]}}]}}\n",
+		sec, 100 + sec, 1000 + sec, pwr);
+}
+
+int main()
+{
+	std::string log;
+	for (int sec = 0; sec < 10; ++sec) {
+		log += line(sec, sec % 2 ? 300 : 100);
+		if (sec == 5) {
+			log += "{\"timestamp\": \"broken\n";
+		}
+	}
+	simdjson::padded_string padded(log);
+	sj::parser parser;
+
+	/* an adaptor takes over a temporary range */
+	{
+		PaddedBuffer source(padded);
+		std::vector<double> pwr;
+		for (const auto &m: Measurements(source, parser, true) | std::views::filter([](const Measurement &m) {
+			return m.pwr > 200;
+		})) {
+			pwr.push_back(m.pwr);
+		}
+		CHECK(pwr == std::vector<double>(5, 300));
+	}
+
+	/* and an lvalue that is moved into it */
+	{
+		PaddedBuffer source(padded);
+		Measurements ms(source, parser, true);
+		std::vector<double> uptimes;
+		for (double uptime: std::move(ms) | std::views::take(3) | std::views::transform(&Measurement::uptime_cur)) {
+			uptimes.push_back(uptime);
+		}
+		CHECK(uptimes == (std::vector<double>{100, 101, 102}));
+	}
+
+	/* an lvalue is iterated in place */
+	{
+		PaddedBuffer source(padded);
+		Measurements ms(source, parser, true);
+		size_t n = 0;
+		for (const auto &m: ms) {
+			CHECK(m.uptime_tot == 1000 + m.uptime_cur - 100);
+			++n;
+		}
+		CHECK(n == 10);
+		CHECK(ms.docs() == 11);
+	}
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fmt/std.h>
+
+#include "budget.hpp"
+#include "check.hpp"
+#include "energy.hpp"
+#include "input.hpp"
+#include "measurements.hpp"
+#include "project.hpp"
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &p)
+{
+	std::ifstream f(p, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), {}};
+}
+
+struct Accounted
+{
+	Result r;
+	size_t docs = 0, measurements = 0;
+};
+
+static Accounted account(const fs::path &log)
+{
+	Accounted a;
+	Accumulator acc;
+	acc.quiet = true;
+	sj::parser parser;
+	InputWindows input(log, MemoryBudget{}.window);
+	Measurements ms(input, parser, true);
+	for (const auto &m: ms) {
+		acc.feed(m);
+		++a.measurements;
+	}
+	a.docs = ms.docs();
+	a.r = std::move(acc.r);
+	return a;
+}
+
+/*
+ * A log projected as `liquidctl-energy project` does by default, which has
+ * to account exactly like the log itself
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+	std::string log = read_file(argv[1]);
+
+	/* halfway through, devices that the projection could get wrong, at the timestamp of a good line */
+	constexpr std::string_view prefix = "{\"timestamp\": \"", data = "\", \"data\": [{";
+	size_t at = log.find('\n', log.size() / 2) + 1;
+	while (!log.substr(at).starts_with(prefix)) {
+		at = log.find('\n', at) + 1;
+	}
+	std::string_view line = std::string_view(log).substr(at, log.find('\n', at) + 1 - at);
+	std::string ts(line.substr(prefix.size(), line.find('"', prefix.size()) - prefix.size()));
+	std::vector<std::string> odd = {
+		/* without a status, or with one that is not an array */
+		fmt::format("{{\"timestamp\": \"{}\", \"data\": [{{\"description\": \"Corsair HX1000i\"}}]}}\n", ts),
+		fmt::format("{{\"timestamp\": \"{}\", \"data\": [{{\"description\": \"Corsair HX1000i\", \"status\": \"n/a\"}}]}}\n", ts),
+		fmt::format("{{\"timestamp\": \"{}\", \"data\": [{{\"status\": null, \"description\": \"Corsair HX1000i\"}}]}}\n", ts),
+		/* another device without a status before the one that is read */
+		std::string(prefix) + ts + std::string(data) + "\"description\": \"NZXT Kraken\"}, {" + std::string(line.substr(prefix.size() + ts.size() + data.size())),
+	};
+	std::string with_odd = log.substr(0, at);
+	for (const auto &l: odd) {
+		with_odd += l;
+	}
+	with_odd += log.substr(at);
+
+	TempDir tmp("lce-project");
+	fs::path original = tmp.path() / "liquidctl.jsonl";
+	fs::path projected = tmp.path() / "projected.jsonl";
+	std::ofstream(original, std::ios::binary) << with_odd;
+
+	Projection p{
+		.devices = {"Corsair HX1000i"},
+		.keys = {"Current uptime", "Total uptime", "Estimated input power"},
+	};
+	ProjectStats stats;
+	{
+		std::FILE *f = std::fopen(projected.c_str(), "wb");
+		if (!f) {
+			throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open {}", projected));
+		}
+		project_log(original, p, f, stats);
+		std::fclose(f);
+	}
+	std::string out = read_file(projected);
+	fmt::print("{} documents, {} broken, {} bytes projected to {}\n", stats.docs, stats.broken, stats.bytes_in, stats.bytes_out);
+	CHECK(stats.bytes_out == out.size() && out.size() < with_odd.size() / 2);
+	for (size_t i = 0; i < 3; ++i) {
+		CHECK(out.find(odd[i]) != out.npos);
+	}
+
+	Accounted expected = account(original), a = account(projected);
+	CHECK(a.docs == expected.docs && stats.docs == expected.docs);
+	CHECK(a.measurements == expected.measurements);
+	CHECK(stats.broken == expected.docs - expected.measurements);
+	auto diffs = compare_results(expected.r, a.r);
+	for (const auto &d: diffs) {
+		fmt::print(stderr, "projected (original vs. this): {}\n", d);
+	}
+	CHECK(diffs.empty());
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "budget.hpp"
+#include "check.hpp"
+#include "energy.hpp"
+#include "input.hpp"
+#include "measurements.hpp"
+#include "rollup.hpp"
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &p)
+{
+	std::ifstream f(p, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), {}};
+}
+
+/* as liquidctl_energy --rollup accounts each log */
+static Result account(const fs::path &log, sj::parser &parser)
+{
+	Accumulator acc;
+	acc.quiet = true;
+	InputWindows input(log, MemoryBudget{}.window);
+	for (const auto &m: Measurements(input, parser, true)) {
+		acc.feed(m);
+	}
+	return acc.r;
+}
+
+/*
+ * A corpus split into the logs of a few hosts, in a hierarchy of uneven
+ * depth: each node has to come up with the merged results of the logs
+ * under it
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fmt::print(stderr, "usage: {} corpus.jsonl\n", argv[0]);
+		return 2;
+	}
+	std::string log = read_file(argv[1]);
+
+	TempDir tmp("lce-rollup");
+	fs::create_directories(tmp.path() / "logs");
+	const char *const names[] = {"a1.jsonl", "a2.jsonl", "b.jsonl", "c.jsonl", "d.jsonl"};
+	std::map<std::string, Result> results;
+	sj::parser parser;
+	for (size_t i = 0, pos = 0; i < std::size(names); ++i) {
+		size_t end = i + 1 == std::size(names) ? log.size() : log.find('\n', log.size() * (i + 1) / std::size(names)) + 1;
+		fs::path path = tmp.path() / "logs" / names[i];
+		std::ofstream(path, std::ios::binary) << log.substr(pos, end - pos);
+		pos = end;
+		results[names[i]] = account(path, parser);
+	}
+
+	/* relative to the file, and absolute */
+	fs::path config = tmp.path() / "fleet.json";
+	std::ofstream(config) << fmt::format(R"({{
+	"site": {{
+		"room-1": {{
+			"rack-1": {{"host-a": ["logs/a1.jsonl", "logs/a2.jsonl"], "host-b": ["logs/b.jsonl"]}}
+		}},
+		"room-2": {{"host-c": ["logs/c.jsonl"]}}
+	}},
+	"lab": {{"host-d": ["{}"]}}
+}})", (tmp.path() / "logs" / "d.jsonl").native());
+
+	auto merged = [&](std::initializer_list<const char *> logs) {
+		Result r{};
+		for (const char *l: logs) {
+			merge(r, results[l]);
+		}
+		return r;
+	};
+	Result host_a = merged({"a1.jsonl", "a2.jsonl"}), host_b = results["b.jsonl"];
+	Result rack_1{}, room_1{}, site{}, lab = results["d.jsonl"];
+	merge(rack_1, host_a);
+	merge(rack_1, host_b);
+	merge(room_1, rack_1);
+	merge(site, room_1);
+	merge(site, results["c.jsonl"]);
+
+	std::map<std::string, std::pair<size_t, const Result *>> expected = {
+		{"site", {0, &site}},
+		{"site/room-1", {1, &room_1}},
+		{"site/room-1/rack-1", {2, &rack_1}},
+		{"site/room-1/rack-1/host-a", {3, &host_a}},
+		{"site/room-1/rack-1/host-b", {3, &host_b}},
+		{"site/room-2", {1, &results["c.jsonl"]}},
+		{"site/room-2/host-c", {2, &results["c.jsonl"]}},
+		{"lab", {0, &lab}},
+		{"lab/host-d", {1, &lab}},
+	};
+
+	for (unsigned threads: {1, 4}) {
+		Rollup rollup(config);
+		rollup.run(threads, account);
+		CHECK(rollup.nodes().size() == expected.size());
+
+		Result everything{};
+		for (size_t i = 0; i < rollup.nodes().size(); ++i) {
+			const auto &node = rollup.nodes()[i];
+			auto it = expected.find(node.name);
+			if (it == expected.end()) {
+				fmt::print(stderr, "unexpected node {}\n", node.name);
+				++failed_checks;
+				continue;
+			}
+			CHECK(node.depth == it->second.first);
+			for (size_t child: node.children) {
+				CHECK(child > i);
+			}
+			for (const auto &d: compare_results(*it->second.second, node.r)) {
+				fmt::print(stderr, "{}, {} threads (expected vs. this): {}\n", node.name, threads, d);
+				++failed_checks;
+			}
+			if (!node.depth) {
+				merge(everything, node.r);
+			}
+		}
+
+		/* and the top levels add up to all of the logs */
+		Result all = merged({"a1.jsonl", "a2.jsonl", "b.jsonl", "c.jsonl", "d.jsonl"});
+		CHECK(everything.power_losses == all.power_losses && everything.anomalies.size() == all.anomalies.size());
+		CHECK(std::abs(everything.total.energy_j - all.total.energy_j) < 1e-6);
+	}
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "check.hpp"
+#include "hash.hpp"
+#include "snapshot.hpp"
+#include "state.hpp"
+
+namespace fs = std::filesystem;
+
+/* as snapshot.cpp lays out the header: slot records a sector apart, and their fields */
+static const constexpr size_t SECTOR = 512;
+static const constexpr size_t SEQ = 12, BODY = 20, CHECKSUM = 36, FIELDS = 44;
+
+static std::string read_file(const fs::path &p)
+{
+	std::ifstream f(p, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), {}};
+}
+
+static void write_file(const fs::path &p, std::string_view data)
+{
+	std::ofstream(p, std::ios::binary | std::ios::trunc) << data;
+}
+
+/* where the body of the record in `slot` is */
+struct Body
+{
+	uint64_t seq, offset, size;
+};
+
+static Body body(std::string_view file, int slot)
+{
+	StateReader r{file.substr(slot * SECTOR + SEQ)};
+	Body b;
+	b.seq = r.get<uint64_t>();
+	b.offset = r.get<uint64_t>();
+	b.size = r.get<uint64_t>();
+	return b;
+}
+
+/* the newest slot that a snapshot would load */
+static int newest(std::string_view file)
+{
+	return body(file, 0).seq > body(file, 1).seq ? 0 : 1;
+}
+
+/* what a fresh snapshot has for `log` */
+static std::optional<std::pair<off_t, std::string>> load(const fs::path &path, const LogFollower &log)
+{
+	FollowSnapshot snapshot(path);
+	if (auto entry = snapshot.find(log)) {
+		return std::pair{entry->offset, std::string(entry->state)};
+	}
+	return std::nullopt;
+}
+
+/*
+ * A snapshot saved twice, and what loading it comes to after either of the
+ * saves was cut short, or after the time zone or the log changed
+ */
+int main()
+{
+	TempDir tmp("lce-snapshot");
+	fs::path log_path = tmp.path() / "liquidctl.jsonl";
+	fs::path path = tmp.path() / "state";
+	write_file(log_path, std::string(100, 'x') + "\n" + std::string(100, 'y') + "\n");
+	LogFollower log(log_path, [](const Measurement &) {});
+
+	auto first = std::pair<off_t, std::string>{101, "first"};
+	auto second = std::pair<off_t, std::string>{202, std::string(5000, 's')};
+	{
+		FollowSnapshot snapshot(path);
+		CHECK(!snapshot.find(log));
+		log.resume(first.first);
+		snapshot.add(log, first.second);
+		snapshot.save();
+		log.resume(second.first);
+		snapshot.add(log, second.second);
+		snapshot.save();
+	}
+	CHECK(load(path, log) == second);
+
+	const std::string saved = read_file(path);
+	int slot = newest(saved);
+	Body b = body(saved, slot);
+	CHECK(b.seq == 2 && body(saved, 1 - slot).seq == 1);
+	CHECK(b.offset + b.size == saved.size());
+
+	/* the newest body corrupt, or cut short: back to the save before */
+	{
+		std::string file = saved;
+		file[b.offset + b.size - 1] ^= 1;
+		write_file(path, file);
+		CHECK(load(path, log) == first);
+
+		write_file(path, std::string_view(saved).substr(0, b.offset + b.size - 1));
+		CHECK(load(path, log) == first);
+	}
+
+	/* the newest record corrupt, or not written at all */
+	{
+		std::string file = saved;
+		file[slot * SECTOR + BODY] ^= 1;
+		write_file(path, file);
+		CHECK(load(path, log) == first);
+
+		std::memset(file.data() + slot * SECTOR, 0, SECTOR);
+		write_file(path, file);
+		CHECK(load(path, log) == first);
+
+		/* and a save after going back to the older record keeps the older body */
+		{
+			FollowSnapshot snapshot(path);
+			log.resume(second.first);
+			snapshot.add(log, "third");
+			snapshot.save();
+		}
+		CHECK(load(path, log) == (std::pair<off_t, std::string>{second.first, "third"}));
+		file = read_file(path);
+		CHECK(newest(file) == slot);
+		file[slot * SECTOR + BODY] ^= 1;
+		write_file(path, file);
+		CHECK(load(path, log) == first);
+	}
+
+	/* a body of another time zone, whose checksums check out: starting over, not going back */
+	{
+		std::string file = saved;
+		StateReader r{std::string_view(file).substr(b.offset)};
+		std::string_view zone = r.get_string();
+		std::memset(file.data() + (zone.data() - file.data()), 'X', zone.size());
+		uint64_t checksum = xxh64(std::string_view(file).substr(b.offset, b.size));
+		std::memcpy(file.data() + slot * SECTOR + CHECKSUM, &checksum, sizeof(checksum));
+		uint64_t fields = xxh64(std::string_view(file).substr(slot * SECTOR, FIELDS));
+		std::memcpy(file.data() + slot * SECTOR + FIELDS, &fields, sizeof(fields));
+		write_file(path, file);
+		CHECK(!load(path, log));
+	}
+
+	/* the log appended to is resumed, but not one with other bytes before the offset, or cut short */
+	write_file(path, saved);
+	{
+		std::ofstream(log_path, std::ios::binary | std::ios::app) << "z\n";
+		CHECK(load(path, log) == second);
+
+		std::fstream f(log_path, std::ios::binary | std::ios::in | std::ios::out);
+		f.seekp(150);
+		f.put('Y');
+		f.close();
+		CHECK(!load(path, log));
+
+		fs::resize_file(log_path, 150);
+		CHECK(!load(path, log));
+	}
+
+	return failed_checks ? 1 : 0;
+}
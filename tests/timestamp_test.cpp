@@ -0,0 +1,99 @@
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "energy.hpp"
+
+using namespace std::chrono;
+
+static std::optional<ts_time> parse(ts_time (*fn)(std::string_view), std::string_view s)
+{
+	try {
+		return fn(s);
+	} catch (const std::runtime_error &) {
+		return std::nullopt;
+	}
+}
+
+/* parse_timestamp_fast() has to agree with parse_timestamp(), on what is valid and on the result */
+static void compare(const std::string &s)
+{
+	auto fast = parse(parse_timestamp_fast, s);
+	auto reference = parse(parse_timestamp, s);
+	if (fast != reference) {
+		fmt::print(stderr, "\"{}\": {} vs. {} by date::parse\n", s,
+			   fast ? fmt::format("{}", fast->time_since_epoch().count()) : "invalid",
+			   reference ? fmt::format("{}", reference->time_since_epoch().count()) : "invalid");
+		++failed_checks;
+	}
+}
+
+int main()
+{
+	fmt::print("Timestamp parsing: {}\n", timestamp_kernel());
+
+	/* 2023-05-31T00:13:57,906371842+03:00 */
+	CHECK(parse_timestamp_fast("2023-05-31T00:13:57,906371842+03:00")
+	      == sys_days{2023y / May / 30} + 21h + 13min + 57s + 906371842ns);
+	CHECK(parse_timestamp_fast("2023-05-31T00:13:57.5-03:30") == sys_days{2023y / May / 31} + 3h + 43min + 57s + 500ms);
+
+	const std::vector<std::string> dates = {
+		"2023-05-31", "2024-02-29", "2023-02-29", "1999-12-31", "2038-01-19", "9999-12-31",
+		"2023-13-01", "2023-00-10", "2023-04-31",
+	};
+	const std::vector<std::string> times = {
+		"00:00:00", "00:13:57", "23:59:59",
+		/* leap second */
+		"23:59:60",
+		"24:00:00", "12:60:00", "12:00:61",
+	};
+	std::vector<std::string> fractions = {"", ",", "."};
+	for (char sep: {',', '.'}) {
+		for (size_t digits = 1; digits <= 12; ++digits) {
+			fractions.push_back(sep + std::string("906371842123").substr(0, digits));
+		}
+		fractions.push_back(sep + std::string("999999999"));
+		fractions.push_back(sep + std::string("000000001"));
+	}
+	const std::vector<std::string> offsets = {
+		"+00:00", "-00:00", "+03:00", "-03:30", "+05:45", "+14:00", "-12:00", "+23:59",
+		"+24:00", "+03:60", "+99:99",
+		/* not %Ez */
+		"Z", "", "+0300", "+03", "+3:00",
+	};
+	for (const auto &date: dates) {
+		for (const auto &time: times) {
+			for (const auto &fraction: fractions) {
+				for (const auto &offset: offsets) {
+					compare(date + "T" + time + fraction + offset);
+				}
+			}
+		}
+	}
+
+	/* other layouts, which go to the fallback */
+	for (const char *s: {
+		"2023-05-31 00:13:57,906371842+03:00",
+		"2023-05-31t00:13:57,906371842+03:00",
+		"2023-5-31T00:13:57,906371842+03:00",
+		"2023-05-31T0:13:57,906371842+03:00",
+		"+2023-05-31T00:13:57,906371842+03:00",
+		"12023-05-31T00:13:57,906371842+03:00",
+		"X023-05-31T00:13:57,906371842+03:00",
+		"2023-05-31T00:13:57,90637184x+03:00",
+		"2023-05-31T00:13:57,906371842+03:00 ",
+		" 2023-05-31T00:13:57,906371842+03:00",
+		"2023-05-31T00:13:57,906371842+03:00x",
+		"2023-05-31T00:13:57,906371842+03:0",
+		"2023-05-31T00:13:57,906371842",
+		"2023-05-31T00:13:57",
+		"2023-05-31",
+		"",
+	}) {
+		compare(s);
+	}
+
+	return failed_checks ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include <fmt/chrono.h>
+
+#include "check.hpp"
+#include "energy.hpp"
+#include "top.hpp"
+
+using namespace std::chrono;
+
+static ts_time utc(const char *s)
+{
+	return parse_timestamp(s);
+}
+
+/* the periods of a query, by their beginning */
+static std::map<ts_time, TopPeriods::Period> run(const std::vector<Measurement> &ms, const TopQuery &q, std::map<ts_time, std::string> *labels = nullptr)
+{
+	Accumulator acc;
+	acc.quiet = true;
+	TopPeriods top(acc.r, q);
+	for (const auto &m: ms) {
+		acc.feed(m);
+		top.feed(m);
+	}
+	std::map<ts_time, TopPeriods::Period> ret;
+	for (const auto &p: top.finish()) {
+		ret[p.begin] = p;
+		if (labels) {
+			(*labels)[p.begin] = top.label(p);
+		}
+	}
+	return ret;
+}
+
+static bool same(const std::map<ts_time, TopPeriods::Period> &periods, const std::map<ts_time, double> &expected)
+{
+	bool ok = periods.size() == expected.size();
+	for (const auto &[begin, energy]: expected) {
+		auto it = periods.find(begin);
+		if (it == periods.end() || std::abs(it->second.energy_j - energy) > 1e-6) {
+			fmt::print(stderr, "period at {}: {} J, expected {} J\n", begin,
+				   it == periods.end() ? 0 : it->second.energy_j, energy);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+/*
+ * --top by local day and hour, in Europe/Berlin across the change to
+ * summer time, with a power loss over midnight: periods begin at the
+ * start of the day or hour, and steps count towards the period of the
+ * measurement they start at, as in the monthly buckets
+ */
+int main()
+{
+	/* every 10 minutes from 22:05 local time, 100 W on the 25th, 200 W on the 26th and 300 W on the 27th */
+	ts_time day26 = utc("2023-03-25T23:00:00+00:00"), day27 = utc("2023-03-26T22:00:00+00:00");
+	ts_time off = utc("2023-03-26T21:55:00+00:00"), on = utc("2023-03-26T22:35:00+00:00");
+	std::vector<Measurement> ms;
+	double uptime_cur = 3600, uptime_tot = 1e6;
+	for (ts_time ts = utc("2023-03-25T21:05:00+00:00"); ts < utc("2023-03-27T01:00:00+00:00"); ts += minutes{10}) {
+		if (ts > off && ts < on) {
+			continue;
+		}
+		if (ts == on) {
+			/* up for 10 minutes, and the total uptime was not saved */
+			uptime_cur = 600;
+			uptime_tot -= 300;
+		}
+		ms.push_back({ts, uptime_cur, uptime_tot, ts < day26 ? 100. : ts < day27 ? 200. : 300.});
+		uptime_cur += 600;
+		uptime_tot += 600;
+	}
+
+	/* the energy of each step, by the local day and hour it counts towards */
+	std::map<ts_time, double> by_days, by_hours, by_days_since;
+	for (size_t i = 1; i < ms.size(); ++i) {
+		const Measurement &prev = ms[i - 1], &m = ms[i];
+		bool power_loss = m.stamp == on;
+		ts_time ts = power_loss ? m.stamp : prev.stamp;
+		double energy = power_loss ? m.pwr * m.uptime_cur : (prev.pwr + m.pwr) / 2 * fp_seconds(m.stamp - prev.stamp).count();
+		ts_time day = ts < day26 ? utc("2023-03-24T23:00:00+00:00") : ts < day27 ? day26 : day27;
+		by_days[day] += energy;
+		/* local hours are whole hours of UTC in this zone */
+		by_hours[floor<hours>(ts)] += energy;
+		if (ts >= day26) {
+			by_days_since[day] += energy;
+		}
+	}
+
+	std::map<ts_time, std::string> labels;
+	auto by_day = run(ms, {.n = 10, .by = TopQuery::DAY}, &labels);
+	CHECK(same(by_day, by_days));
+	/* the day of the change is a single period, 23 hours long */
+	CHECK(labels[day26] == "2023-03-26");
+	CHECK(by_day[day26].end == ms[(off - ms.front().stamp) / minutes{10}].stamp);
+
+	auto by_hour = run(ms, {.n = 100, .by = TopQuery::HOUR}, &labels);
+	CHECK(same(by_hour, by_hours));
+	/* 01:00 is followed by 03:00 */
+	CHECK(labels[utc("2023-03-26T00:00:00+00:00")] == "2023-03-26 01:00");
+	CHECK(labels[utc("2023-03-26T01:00:00+00:00")] == "2023-03-26 03:00");
+
+	/* from midnight on, the step from the 25th into the 26th does not count */
+	CHECK(same(run(ms, {.n = 10, .by = TopQuery::DAY, .since = day26}), by_days_since));
+
+	/* the costliest first, and only as many as asked for */
+	auto top = [&] {
+		Accumulator acc;
+		acc.quiet = true;
+		TopPeriods top(acc.r, {.n = 1, .by = TopQuery::DAY});
+		for (const auto &m: ms) {
+			acc.feed(m);
+			top.feed(m);
+		}
+		return top.finish();
+	}();
+	CHECK(top.size() == 1 && top[0].begin == day26);
+
+	return failed_checks ? 1 : 0;
+}
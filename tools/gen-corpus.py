@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Generates a synthetic liquidctl log for benchmarking, shaped like the
+output of `liquidctl status --json` with a timestamp prepended.
+"""
+
+import argparse
+import datetime
+import random
+import sys
+
+
+def format_timestamp(stamp, separator, digits):
+    ts = stamp.strftime('%Y-%m-%dT%H:%M:%S')
+    if digits:
+        ts += separator + f'{stamp.microsecond:06d}000000'[:digits]
+    offset = stamp.strftime('%z')
+    return ts + offset[:-2] + ':' + offset[-2:]
+
+
+def fuzz_timestamp(rng, stamp):
+    zone = datetime.timezone(datetime.timedelta(minutes=rng.choice([0, 180, -330, 345, 840, -720])))
+    return format_timestamp(stamp.astimezone(zone), rng.choice(',.'), rng.randrange(13))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument('--rate', type=float, default=0.2, help='samples per second (default: %(default)s)')
+    ap.add_argument('--duration', type=float, default=86400, help='seconds of log to generate (default: %(default)s)')
+    ap.add_argument('--start', default='2023-05-31T00:00:00+03:00', help='timestamp of the first sample')
+    ap.add_argument('--power-losses', type=int, default=0, help='number of power losses to simulate')
+    ap.add_argument('--fuzz', action='store_true',
+                    help='vary timestamp precision and time zones, jitter the wall clock, '
+                         'and throw in corrupt and repeated documents')
+    ap.add_argument('--seed', type=int, default=0)
+    ap.add_argument('-o', '--output', type=argparse.FileType('w'), default=sys.stdout)
+    args = ap.parse_args()
+
+    rng = random.Random(args.seed)
+    step = 1 / args.rate
+    count = int(args.duration * args.rate)
+    losses = set(rng.randrange(1, count) for _ in range(args.power_losses)) if count > 1 else set()
+
+    stamp = datetime.datetime.fromisoformat(args.start)
+    uptime_cur = 3600.0
+    uptime_tot = 1e6
+    pwr = 150.0
+    out = args.output
+
+    for i in range(count):
+        if i in losses:
+            # the PSU was off for a while, and has been up for a bit before
+            # it got polled, yet its total uptime was not saved
+            stamp += datetime.timedelta(seconds=rng.uniform(60, 3600))
+            uptime_cur = rng.uniform(5, 60)
+
+        pwr = min(max(pwr + rng.gauss(0, 5), 40.0), 900.0)
+        if args.fuzz:
+            ts = fuzz_timestamp(rng, stamp + datetime.timedelta(seconds=rng.uniform(-1.5, 1.5)))
+        else:
+            ts = format_timestamp(stamp, ',', 9)
+        line = (
+            f'{{"timestamp": "{ts}", "data": [{{"bus": "hid", "address": "/dev/hidraw3", '
+            f'"description": "Corsair HX1000i", "status": ['
+            f'{{"key": "Current uptime", "value": {uptime_cur:.1f}, "unit": "s"}}, '
+            f'{{"key": "Total uptime", "value": {uptime_tot:.1f}, "unit": "s"}}, '
+            f'{{"key": "Temperature 1", "value": {rng.uniform(35, 45):.1f}, "unit": "°C"}}, '
+            f'{{"key": "Fan speed", "value": 0, "unit": "rpm"}}, '
+            f'{{"key": "Input voltage", "value": 230.0, "unit": "V"}}, '
+            f'{{"key": "Total power output", "value": {pwr * 0.9:.2f}, "unit": "W"}}, '
+            f'{{"key": "Estimated input power", "value": {pwr:.2f}, "unit": "W"}}, '
+            f'{{"key": "Estimated efficiency", "value": 90, "unit": "%"}}]}}]}}\n'
+        )
+        if args.fuzz and rng.random() < 0.001:
+            line = line[:rng.randrange(len(line) - 1)] + '\n'
+        if args.fuzz and rng.random() < 0.001:
+            out.write(line)
+        out.write(line)
+
+        stamp += datetime.timedelta(seconds=step)
+        uptime_cur += step
+        uptime_tot += step
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,60 @@
+#
+# Runs liquidctl_energy --stats --memory-limit over a corpus at each of the
+# given limits, failing if the peak resident size goes over the limit or
+# the report differs from an unlimited run.
+#
+#   cmake -DBINARY=<liquidctl_energy> -DCORPUS=<corpus.jsonl>
+#         [-DLIMITS=<size;...>] -P mem-check.cmake
+#
+
+if(NOT DEFINED LIMITS)
+	set(LIMITS 8M 16M 64M)
+endif()
+
+execute_process(
+	COMMAND "${BINARY}" "${CORPUS}"
+	OUTPUT_VARIABLE expected
+	ERROR_QUIET
+	RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "${BINARY} failed (${result})")
+endif()
+
+foreach(limit IN LISTS LIMITS)
+	if(NOT limit MATCHES "^([0-9]+)([KMG]?)$")
+		message(FATAL_ERROR "Invalid limit: ${limit}")
+	endif()
+	set(limit_bytes ${CMAKE_MATCH_1})
+	if(CMAKE_MATCH_2 STREQUAL "K")
+		math(EXPR limit_bytes "${limit_bytes} << 10")
+	elseif(CMAKE_MATCH_2 STREQUAL "M")
+		math(EXPR limit_bytes "${limit_bytes} << 20")
+	elseif(CMAKE_MATCH_2 STREQUAL "G")
+		math(EXPR limit_bytes "${limit_bytes} << 30")
+	endif()
+
+	execute_process(
+		COMMAND "${BINARY}" --stats --memory-limit ${limit} "${CORPUS}"
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE stats
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${BINARY} --memory-limit ${limit} failed (${result}):\n${stats}")
+	endif()
+	if(NOT output STREQUAL expected)
+		message(FATAL_ERROR "Report with --memory-limit ${limit} differs from an unlimited run")
+	endif()
+
+	if(NOT stats MATCHES "Processed .* ([0-9.]+ MB/s).*Peak resident size: ([0-9]+)\\.([0-9]) MB")
+		message(FATAL_ERROR "No statistics in the output of ${BINARY}:\n${stats}")
+	endif()
+	set(throughput "${CMAKE_MATCH_1}")
+	math(EXPR peak_bytes "${CMAKE_MATCH_2} * 1000000 + ${CMAKE_MATCH_3} * 100000")
+
+	message(STATUS "--memory-limit ${limit}: peak resident size ${CMAKE_MATCH_2}.${CMAKE_MATCH_3} MB, ${throughput}")
+	if(peak_bytes GREATER limit_bytes)
+		message(FATAL_ERROR "Peak resident size went over --memory-limit ${limit}")
+	endif()
+endforeach()
@@ -0,0 +1,100 @@
+#
+# Runs liquidctl_energy --stats over a corpus and compares its throughput
+# with a stored baseline, failing on regressions beyond a tolerance.
+#
+#   cmake -DBINARY=<liquidctl_energy> -DCORPUS=<corpus.jsonl> -DBASELINE=<perf-baseline.txt>
+#         [-DBUILD_TYPE=<type>] [-DTOLERANCE=<percent>] [-DRUNS=<n>] [-DRECORD=ON] -P perf-check.cmake
+#
+# With RECORD, the measurement is written to BASELINE instead, along with
+# the build type and the CPU. Numbers from another build type or another
+# CPU are not comparable; the check is skipped then.
+#
+
+if(NOT DEFINED TOLERANCE)
+	set(TOLERANCE 10)
+endif()
+if(NOT DEFINED RUNS)
+	set(RUNS 5)
+endif()
+if(NOT BUILD_TYPE)
+	set(BUILD_TYPE None)
+endif()
+cmake_host_system_information(RESULT cpu QUERY PROCESSOR_DESCRIPTION)
+
+if(NOT RECORD)
+	if(NOT EXISTS "${BASELINE}")
+		message(FATAL_ERROR "No baseline at ${BASELINE}, record one with the perf-baseline target")
+	endif()
+	file(STRINGS "${BASELINE}" baseline)
+	foreach(line IN LISTS baseline)
+		if(line MATCHES "^([a-z_]+) (.+)$")
+			set(baseline_${CMAKE_MATCH_1} "${CMAKE_MATCH_2}")
+		endif()
+	endforeach()
+
+	if(NOT baseline_build_type STREQUAL BUILD_TYPE OR NOT baseline_cpu STREQUAL cpu)
+		message(STATUS "Skipping: ${BASELINE} is of a ${baseline_build_type} build on ${baseline_cpu}, "
+			"this is a ${BUILD_TYPE} build on ${cpu}")
+		return()
+	endif()
+endif()
+
+# best of RUNS, to filter out noise from the rest of the system
+set(best_mbps 0)
+set(best_ns 0)
+foreach(run RANGE 1 ${RUNS})
+	execute_process(
+		COMMAND "${BINARY}" --stats "${CORPUS}"
+		OUTPUT_QUIET
+		ERROR_VARIABLE stats
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${BINARY} failed (${result}):\n${stats}")
+	endif()
+
+	if(NOT stats MATCHES "Processed [0-9]+ documents \\([0-9.]+ MB\\) in [0-9.]+ s: ([0-9]+)\\.([0-9]) MB/s, ([0-9]+) ns/document")
+		message(FATAL_ERROR "No statistics in the output of ${BINARY}:\n${stats}")
+	endif()
+	# in tenths of MB/s, as math() only does integers
+	math(EXPR mbps "${CMAKE_MATCH_1} * 10 + ${CMAKE_MATCH_2}")
+	set(ns ${CMAKE_MATCH_3})
+
+	if(mbps GREATER best_mbps)
+		set(best_mbps ${mbps})
+	endif()
+	if(best_ns EQUAL 0 OR ns LESS best_ns)
+		set(best_ns ${ns})
+	endif()
+endforeach()
+
+function(format_mbps var tenths)
+	math(EXPR whole "${tenths} / 10")
+	math(EXPR frac "${tenths} % 10")
+	set(${var} "${whole}.${frac} MB/s" PARENT_SCOPE)
+endfunction()
+format_mbps(best_mbps_str ${best_mbps})
+
+if(RECORD)
+	file(WRITE "${BASELINE}"
+		"# Throughput baseline for perf-check, recorded by the perf-baseline target:\n"
+		"# best of ${RUNS} runs of liquidctl_energy --stats over the corpus target\n"
+		"build_type ${BUILD_TYPE}\n"
+		"cpu ${cpu}\n"
+		"mbps_tenths ${best_mbps}\n"
+		"ns_per_document ${best_ns}\n"
+	)
+	message(STATUS "Recorded baseline: ${best_mbps_str}, ${best_ns} ns/document (${BUILD_TYPE} build on ${cpu})")
+	return()
+endif()
+
+math(EXPR min_mbps "${baseline_mbps_tenths} * (100 - ${TOLERANCE}) / 100")
+math(EXPR max_ns "${baseline_ns_per_document} * (100 + ${TOLERANCE}) / 100")
+
+format_mbps(baseline_mbps_str ${baseline_mbps_tenths})
+message(STATUS "Throughput: ${best_mbps_str} (baseline ${baseline_mbps_str}), "
+	"${best_ns} ns/document (baseline ${baseline_ns_per_document})")
+
+if(best_mbps LESS min_mbps OR best_ns GREATER max_ns)
+	message(FATAL_ERROR "Performance regressed by more than ${TOLERANCE}% against ${BASELINE}")
+endif()
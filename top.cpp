@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <ctime>
+
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+
+#include "state.hpp"
+#include "top.hpp"
+
+using namespace std::chrono;
+
+/* `ts` as local time, broken down for formatting (fmt before 10 formats a sys_time in the C library's zone) */
+static std::tm local_wall(ts_time ts)
+{
+	std::time_t t = system_clock::to_time_t(floor<seconds>(ts) + local_zone()->get_info(ts).offset);
+	std::tm tm;
+	gmtime_r(&t, &tm);
+	return tm;
+}
+
+/*
+ * The local day or hour that `ts` is in, and the span of time around `ts`
+ * within which it stays the same -- like GroupKey::from_time().
+ */
+static local_seconds local_period(ts_time ts, TopQuery::Period by, ts_time &begin, ts_time &end)
+{
+	auto info = local_zone()->get_info(ts);
+	auto ts_local = local_time<nanoseconds>{ts.time_since_epoch() + info.offset};
+	local_seconds start = by == TopQuery::DAY ? local_seconds{floor<days>(ts_local)} : floor<hours>(ts_local);
+	local_seconds stop = start + (by == TopQuery::DAY ? seconds{days{1}} : seconds{hours{1}});
+	/* sys_info bounds may be far beyond the range of ts_time, compare them at their own precision */
+	begin = std::max(info.begin, sys_seconds{start.time_since_epoch()} - info.offset);
+	end = std::min(info.end, sys_seconds{stop.time_since_epoch()} - info.offset);
+	return start;
+}
+
+TopPeriods::TopPeriods(const Result &r, const TopQuery &query)
+	: r_(r)
+	, query_(query)
+	, power_losses_(r.power_losses)
+{
+}
+
+void TopPeriods::feed(const Measurement &m)
+{
+	double energy = r_.total.energy_j - energy_;
+	energy_ = r_.total.energy_j;
+	/* like account_step(): to the period of the measurement before, but a power loss to that of this one */
+	bool power_loss = r_.power_losses != power_losses_;
+	power_losses_ = r_.power_losses;
+	if (!power_loss) {
+		count(prev_, energy);
+	}
+	prev_ = m.stamp;
+
+	if (query_.by == TopQuery::SESSION) {
+		if (!open_ || r_.rollovers != rollovers_) {
+			close();
+			rollovers_ = r_.rollovers;
+			open(m.stamp - duration_cast<ts_time::duration>(fp_seconds{m.uptime_cur}));
+		}
+	} else {
+		/* timestamps may jitter backwards a little, do not reopen a period that has been closed */
+		latest_ = std::max(latest_, m.stamp);
+		if (!open_ || latest_ >= span_end_) {
+			/* a day with a DST change is two spans */
+			ts_time span_begin;
+			auto local = local_period(latest_, query_.by, span_begin, span_end_);
+			if (!open_ || local != local_) {
+				close();
+				local_ = local;
+				/* at the start of the day or hour rather than at the first measurement in it */
+				open(local_zone()->to_sys(local, choose::earliest));
+			}
+		}
+	}
+
+	period_.end = std::max(period_.end, m.stamp);
+	if (power_loss) {
+		count(m.stamp, energy);
+	}
+}
+
+void TopPeriods::count(ts_time ts, double energy)
+{
+	if (open_ && ts >= query_.since && ts < query_.until) {
+		period_.energy_j += energy;
+		counted_ = true;
+	}
+}
+
+void TopPeriods::open(ts_time begin)
+{
+	period_ = {begin, begin, 0};
+	open_ = true;
+	counted_ = false;
+}
+
+void TopPeriods::close()
+{
+	if (!open_ || !counted_) {
+		open_ = false;
+		return;
+	}
+	open_ = false;
+
+	if (top_.size() < query_.n) {
+		top_.push(period_);
+	} else if (query_.n && period_.energy_j > top_.top().energy_j) {
+		top_.pop();
+		top_.push(period_);
+	}
+}
+
+std::vector<TopPeriods::Period> TopPeriods::finish()
+{
+	close();
+
+	std::vector<Period> ret;
+	for (; !top_.empty(); top_.pop()) {
+		ret.push_back(top_.top());
+	}
+	std::reverse(ret.begin(), ret.end());
+	return ret;
+}
+
+static void put_period(StateWriter &w, const TopPeriods::Period &p)
+{
+	w.put<int64_t>(p.begin.time_since_epoch().count());
+	w.put<int64_t>(p.end.time_since_epoch().count());
+	w.put<double>(p.energy_j);
+}
+
+static TopPeriods::Period get_period(StateReader &r)
+{
+	TopPeriods::Period p;
+	p.begin = ts_time{ts_time::duration{r.get<int64_t>()}};
+	p.end = ts_time{ts_time::duration{r.get<int64_t>()}};
+	p.energy_j = r.get<double>();
+	return p;
+}
+
+void TopPeriods::save(StateWriter &w) const
+{
+	w.put<uint64_t>(query_.n);
+	w.put<uint8_t>(query_.by);
+	w.put<int64_t>(query_.since.time_since_epoch().count());
+	w.put<int64_t>(query_.until.time_since_epoch().count());
+
+	/* a copy, to get at the contents */
+	auto top = top_;
+	w.put<uint64_t>(top.size());
+	for (; !top.empty(); top.pop()) {
+		put_period(w, top.top());
+	}
+
+	w.put<uint8_t>(open_);
+	w.put<uint8_t>(counted_);
+	put_period(w, period_);
+	w.put<double>(energy_);
+	w.put<int64_t>(local_.time_since_epoch().count());
+	w.put<int64_t>(span_end_.time_since_epoch().count());
+	w.put<int64_t>(latest_.time_since_epoch().count());
+	w.put<uint32_t>(rollovers_);
+	w.put<uint32_t>(power_losses_);
+	w.put<int64_t>(prev_.time_since_epoch().count());
+}
+
+void TopPeriods::restore(StateReader &r)
+{
+	if (r.get<uint64_t>() != query_.n
+	    || r.get<uint8_t>() != query_.by
+	    || r.get<int64_t>() != query_.since.time_since_epoch().count()
+	    || r.get<int64_t>() != query_.until.time_since_epoch().count()) {
+		throw std::runtime_error("--top has changed");
+	}
+
+	top_ = {};
+	for (auto n = r.get<uint64_t>(); n; --n) {
+		top_.push(get_period(r));
+	}
+
+	open_ = r.get<uint8_t>();
+	counted_ = r.get<uint8_t>();
+	period_ = get_period(r);
+	energy_ = r.get<double>();
+	local_ = local_seconds{seconds{r.get<int64_t>()}};
+	span_end_ = ts_time{ts_time::duration{r.get<int64_t>()}};
+	latest_ = ts_time{ts_time::duration{r.get<int64_t>()}};
+	rollovers_ = r.get<uint32_t>();
+	power_losses_ = r.get<uint32_t>();
+	prev_ = ts_time{ts_time::duration{r.get<int64_t>()}};
+}
+
+std::string TopPeriods::label(const Period &p) const
+{
+	switch (query_.by) {
+	case TopQuery::DAY:
+		return fmt::format("{:%F}", local_wall(p.begin));
+	case TopQuery::HOUR:
+		return fmt::format("{:%F %H}:00", local_wall(p.begin));
+	case TopQuery::SESSION:
+		return fmt::format("{:%F %T} to {:%F %T}", local_wall(p.begin), local_wall(p.end));
+	}
+	return {};
+}
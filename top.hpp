@@ -0,0 +1,89 @@
+#pragma once
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "energy.hpp"
+
+struct StateReader;
+struct StateWriter;
+
+struct TopQuery
+{
+	enum Period { DAY, HOUR, SESSION };
+
+	size_t n;
+	Period by;
+	/* only energy from steps that count towards measurements within [since, until) counts */
+	ts_time since = ts_time::min(), until = ts_time::max();
+};
+
+/*
+ * The N periods -- local days or hours, or spans between PSU power
+ * cycles -- with the most energy, found in the same pass as the rest of
+ * the accounting.
+ *
+ * Measurements come in order, so periods are closed one by one: only the
+ * open period and a min-heap of the N costliest closed ones are kept,
+ * however many periods the log spans. Like monthly buckets, the energy
+ * of a step goes to the period of the measurement that the step starts
+ * at, and that of a power loss to the period of the measurement after it.
+ */
+class TopPeriods
+{
+public:
+	struct Period
+	{
+		/*
+		 * The start of the day or hour, or of the session going by the
+		 * PSU's uptime; the last measurement in the period
+		 */
+		ts_time begin, end;
+		double energy_j;
+		double energy_kwh() const { return energy_j / 3600 / 1000; }
+	};
+
+	/* to be fed after the accumulator that `r` belongs to */
+	TopPeriods(const Result &r, const TopQuery &query);
+
+	void feed(const Measurement &m);
+	/* costliest first */
+	std::vector<Period> finish();
+
+	/* e.g. "2023-05-30 21:00" */
+	std::string label(const Period &p) const;
+
+	/* for FollowSnapshot; restore() throws if the query has changed since */
+	void save(StateWriter &w) const;
+	void restore(StateReader &r);
+
+private:
+	struct Cheaper
+	{
+		bool operator()(const Period &a, const Period &b) const { return a.energy_j > b.energy_j; }
+	};
+
+	void open(ts_time begin);
+	void close();
+	/* `energy` to the open period, as that of the measurement at `ts` */
+	void count(ts_time ts, double energy);
+
+	const Result &r_;
+	TopQuery query_;
+	std::priority_queue<Period, std::vector<Period>, Cheaper> top_;
+
+	bool open_ = false, counted_ = false;
+	Period period_{};
+	/* total energy after the last measurement */
+	double energy_ = 0;
+
+	/* the open day or hour, and the span of time within which it stays the same */
+	std::chrono::local_seconds local_{};
+	ts_time span_end_{};
+	ts_time latest_ = ts_time::min();
+
+	unsigned rollovers_ = 0, power_losses_;
+	/* the last measurement, which the next step starts at */
+	ts_time prev_{};
+};